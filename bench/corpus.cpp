@@ -0,0 +1,127 @@
+#include "corpus.h"
+
+#include <random>
+
+using namespace omfl::bench;
+
+namespace {
+
+    void AppendScalar(std::string& text, std::mt19937& random) {
+        switch (random() % 4) {
+            case 0:
+                text += std::to_string(static_cast<int32_t>(random()));
+                break;
+            case 1:
+                text += std::to_string(static_cast<double>(random() % 1000000) / 1000.0);
+                break;
+            case 2:
+                text += (random() & 1) ? "true" : "false";
+                break;
+            default:
+                text += "\"value_" + std::to_string(random() % 10000) + '"';
+                break;
+        }
+    }
+
+    void AppendArray(std::string& text, const CorpusShape& shape, size_t depth, std::mt19937& random) {
+        text += '[';
+        for (size_t i = 0; i < shape.array_length; i++) {
+            if (i != 0) {
+                text += ", ";
+            }
+            if (depth > 1) {
+                AppendArray(text, shape, depth - 1, random);
+            } else {
+                AppendScalar(text, random);
+            }
+        }
+        text += ']';
+    }
+
+    void AppendString(std::string& text, size_t length, std::mt19937& random) {
+        static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 .:;-+/";
+        text += '"';
+        for (size_t i = 0; i < length; i++) {
+            text += kAlphabet[random() % (sizeof(kAlphabet) - 1)];
+        }
+        text += '"';
+    }
+}
+
+Corpus omfl::bench::GenerateCorpus(const CorpusShape& shape) {
+    Corpus corpus;
+    std::mt19937 random(shape.seed);
+    std::string& text = corpus.text;
+
+    for (size_t s = 0; s < shape.sections; s++) {
+        std::string section = "s" + std::to_string(s);
+        for (size_t level = 1; level < shape.depth; level++) {
+            section += ".n" + std::to_string(level);
+        }
+        text += '[' + section + "]\n";
+
+        for (size_t k = 0; k < shape.keys_per_section; k++) {
+            for (size_t c = 0; c < shape.comment_lines; c++) {
+                text += "# comment line " + std::to_string(c) + " about the next key, with = and [brackets]\n";
+            }
+            std::string key = "key_" + std::to_string(k);
+            text += key + " = ";
+            if (shape.array_length != 0) {
+                AppendArray(text, shape, shape.array_depth, random);
+            } else if (shape.string_length != 0) {
+                AppendString(text, shape.string_length, random);
+            } else {
+                AppendScalar(text, random);
+            }
+            if (shape.trailing_comments) {
+                text += "  # trailing comment";
+            }
+            text += '\n';
+            corpus.paths.push_back(section + '.' + key);
+        }
+    }
+    return corpus;
+}
+
+std::vector<NamedShape> omfl::bench::StandardShapes() {
+    std::vector<NamedShape> shapes;
+
+    CorpusShape wide;
+    wide.keys_per_section = 200000;
+    shapes.push_back({"wide", wide});
+
+    CorpusShape deep;
+    deep.sections = 5000;
+    deep.keys_per_section = 20;
+    deep.depth = 12;
+    shapes.push_back({"deep", deep});
+
+    CorpusShape arrays;
+    arrays.sections = 100;
+    arrays.keys_per_section = 100;
+    arrays.array_length = 8;
+    arrays.array_depth = 3;
+    shapes.push_back({"arrays", arrays});
+
+    CorpusShape strings;
+    strings.sections = 100;
+    strings.keys_per_section = 40;
+    strings.string_length = 1024;
+    shapes.push_back({"strings", strings});
+
+    CorpusShape comments;
+    comments.sections = 200;
+    comments.keys_per_section = 200;
+    comments.comment_lines = 2;
+    comments.trailing_comments = true;
+    shapes.push_back({"comments", comments});
+
+    CorpusShape mixed;
+    mixed.sections = 2000;
+    mixed.keys_per_section = 50;
+    mixed.depth = 3;
+    mixed.comment_lines = 1;
+    shapes.push_back({"mixed", mixed});
+
+    return shapes;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace omfl::bench {
+
+    // Shape of a synthetic OMFL document. Every knob is independent, so the named
+    // shapes below are only starting points.
+    struct CorpusShape {
+        size_t sections = 1;
+        size_t keys_per_section = 1000;
+        // Number of dotted components in each section name: [s0.n1.n2...].
+        size_t depth = 1;
+        // Every key holds an array of this many elements, nested array_depth levels.
+        size_t array_length = 0;
+        size_t array_depth = 1;
+        // Every key holds a string of this length.
+        size_t string_length = 0;
+        // Comment lines before every key and a trailing comment after every value.
+        size_t comment_lines = 0;
+        bool trailing_comments = false;
+        uint32_t seed = 1;
+    };
+
+    struct Corpus {
+        std::string text;
+        // Full dotted paths of every value, in document order.
+        std::vector<std::string> paths;
+    };
+
+    Corpus GenerateCorpus(const CorpusShape& shape);
+
+    struct NamedShape {
+        const char* name;
+        CorpusShape shape;
+    };
+
+    // Wide, deep, arrays, strings, comments and mixed documents of a few megabytes.
+    std::vector<NamedShape> StandardShapes();
+}
@@ -0,0 +1,322 @@
+#include "bench/corpus.h"
+#include "lib/lazy.h"
+#include "lib/msgpack.h"
+#include "lib/parser.h"
+#include "lib/transcode.h"
+#include "lib/writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <random>
+
+using namespace omfl;
+using namespace omfl::bench;
+
+namespace {
+
+    std::atomic<size_t> allocations{0};
+}
+
+// Every allocation of the process goes through here, so a benchmark can report how
+// many of them one run of the measured operation made.
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+    struct Measurement {
+        double seconds;
+        size_t allocations;
+    };
+
+    // Runs body until it has been timed at least three times and for a quarter of a
+    // second, and keeps the fastest run.
+    template<typename Body>
+    Measurement Measure(Body&& body) {
+        Measurement best{1e100, 0};
+        double total = 0;
+        for (size_t runs = 0; runs < 3 || total < 0.25; runs++) {
+            size_t allocations_before = allocations.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            size_t made = allocations.load(std::memory_order_relaxed) - allocations_before;
+            total += seconds;
+            if (seconds < best.seconds) {
+                best = {seconds, made};
+            }
+        }
+        return best;
+    }
+
+    void PrintThroughput(const char* shape, const char* operation, size_t bytes, const Measurement& result) {
+        std::printf("%-10s %-22s %10.1f MB/s %12.2f ms %12zu allocs\n", shape, operation,
+                    bytes / result.seconds / 1e6, result.seconds * 1e3, result.allocations);
+    }
+
+    void PrintLatency(const char* shape, const char* operation, size_t count, const Measurement& result) {
+        std::printf("%-10s %-22s %10.1f ns/op %11.2f ms %12zu allocs\n", shape, operation,
+                    result.seconds * 1e9 / count, result.seconds * 1e3, result.allocations);
+    }
+
+#ifdef OMFL_ENABLE_STATS
+    void PrintStats(const char* shape, const ParseStats& stats) {
+        std::printf("%-10s stats: %llu lines, %llu sections, %llu keys, %llu elements; "
+                    "tokenize %.2f ms, convert %.2f ms, build %.2f ms; peak %.1f MB; longest scan %u\n",
+                    shape, static_cast<unsigned long long>(stats.lines), static_cast<unsigned long long>(stats.sections),
+                    static_cast<unsigned long long>(stats.keys), static_cast<unsigned long long>(stats.array_elements),
+                    stats.tokenize_ns / 1e6, stats.convert_ns / 1e6, stats.build_ns / 1e6,
+                    stats.peak_node_bytes / 1e6, stats.longest_find_scan);
+    }
+#endif
+
+    void ParseAndDrop(const std::string& code, const ParseOptions& options) {
+        parse(code, options);
+    }
+
+    void ParseAndDrop(const std::filesystem::path& path, const ParseOptions& options) {
+        parse(path, options);
+    }
+
+    void BenchShape(const NamedShape& named, const std::filesystem::path& directory) {
+        Corpus corpus = GenerateCorpus(named.shape);
+        const char* name = named.name;
+        std::filesystem::path input = directory / (std::string(name) + ".omfl");
+        {
+            std::ofstream file(input, std::ios::binary);
+            file << corpus.text;
+        }
+
+        const Document root = parse(corpus.text);
+        if (!root.valid() || root.Get(corpus.paths.back()).node().type == NodeType::kNone) {
+            std::printf("%-10s generated document did not parse\n", name);
+            return;
+        }
+        OMFL_STATS(PrintStats(name, root.stats());)
+
+        PrintThroughput(name, "parse(string)", corpus.text.size(), Measure([&] {
+            ParseAndDrop(corpus.text, {});
+        }));
+        ParseOptions parallel;
+        parallel.threads = 0;
+        PrintThroughput(name, "parse(string, threads)", corpus.text.size(), Measure([&] {
+            ParseAndDrop(corpus.text, parallel);
+        }));
+        PrintThroughput(name, "parse(path)", corpus.text.size(), Measure([&] {
+            ParseAndDrop(input, {});
+        }));
+        ParseOptions mapped;
+        mapped.map_file = true;
+        PrintThroughput(name, "parse(path, mmap)", corpus.text.size(), Measure([&] {
+            ParseAndDrop(input, mapped);
+        }));
+        // Opening the file lazily and reading one value: only its top-level section is parsed.
+        PrintThroughput(name, "LazyDocument(path) + Get", corpus.text.size(), Measure([&] {
+            LazyDocument lazy(input);
+            lazy.Get(corpus.paths.back());
+        }));
+
+        // Lookups walk a fixed pseudo-random sample so every shape does the same amount of work.
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < 100000; i++) {
+            paths.push_back(corpus.paths[(i * 7919) % corpus.paths.size()]);
+        }
+        std::vector<CompiledPath> compiled(paths.begin(), paths.end());
+        size_t found = 0;
+        PrintLatency(name, "Get(string)", paths.size(), Measure([&] {
+            for (const std::string& path : paths) {
+                found += root.Get(path).IsSection() ? 0 : 1;
+            }
+        }));
+        PrintLatency(name, "Get(CompiledPath)", compiled.size(), Measure([&] {
+            for (const CompiledPath& path : compiled) {
+                found += root.Get(path).IsSection() ? 0 : 1;
+            }
+        }));
+        if (found == 0) {
+            std::printf("%-10s lookups found nothing\n", name);
+        }
+
+        const std::string& sample = corpus.paths[corpus.paths.size() / 2];
+        std::string pattern = "**." + sample.substr(sample.rfind('.') + 1);
+        Document indexed = root.Clone();
+        indexed.IndexPaths();
+        size_t matches = 0;
+        PrintLatency(name, "Query(**.key)", 100, Measure([&] {
+            for (size_t i = 0; i < 100; i++) {
+                matches += root.Query(pattern).size();
+            }
+        }));
+        PrintLatency(name, "Query(**.key), indexed", 100, Measure([&] {
+            for (size_t i = 0; i < 100; i++) {
+                matches += indexed.Query(pattern).size();
+            }
+        }));
+        if (matches == 0) {
+            std::printf("%-10s queries found nothing\n", name);
+        }
+
+        std::filesystem::path output = directory / "output";
+        auto bench_export = [&](const char* operation, void (Section::*create)(const std::filesystem::path&) const) {
+            Measurement result = Measure([&] {
+                (root.*create)(output);
+            });
+            PrintThroughput(name, operation, std::filesystem::file_size(output), result);
+        };
+        bench_export("CreateJSON", &Section::CreateJSON);
+        bench_export("CreateYAML", &Section::CreateYAML);
+        bench_export("CreateXML", &Section::CreateXML);
+        bench_export("CreateMsgPack", &Section::CreateMsgPack);
+        {
+            std::string packed;
+            StringSink sink(packed);
+            root.WriteMsgPack(sink);
+            PrintThroughput(name, "load_msgpack(string)", packed.size(), Measure([&] {
+                load_msgpack(packed);
+            }));
+        }
+        // All three formats at once: one walk of the tree per thread.
+        std::vector<ExportTarget> targets = {{Format::kJson, directory / (std::string(name) + ".json")},
+                                             {Format::kYaml, directory / (std::string(name) + ".yaml")},
+                                             {Format::kXml, directory / (std::string(name) + ".xml")}};
+        for (size_t threads : {1, 0}) {
+            Measurement result = Measure([&] {
+                root.Export(targets, threads);
+            });
+            size_t bytes = 0;
+            for (const ExportTarget& target : targets) {
+                bytes += std::filesystem::file_size(target.path);
+            }
+            PrintThroughput(name, threads == 1 ? "Export all, 1 thread" : "Export all, threads", bytes, result);
+        }
+        for (const ExportTarget& target : targets) {
+            std::filesystem::remove(target.path);
+        }
+        // Straight from the input file to JSON, without a tree in between.
+        PrintThroughput(name, "transcode(path) JSON", corpus.text.size(), Measure([&] {
+            FileSink sink(output);
+            JsonWriter writer(sink);
+            transcode(input, writer);
+        }));
+
+        std::filesystem::remove(output);
+        std::filesystem::remove(input);
+    }
+
+    // Loads one flat section with a growing number of keys. With the key index the
+    // time per key has to stay flat instead of growing with the section size.
+    void BenchWideSection() {
+        std::printf("%10s %12s %12s\n", "keys", "total, ms", "ns / key");
+        for (size_t keys = 1024; keys <= 256 * 1024; keys *= 4) {
+            CorpusShape shape;
+            shape.keys_per_section = keys;
+            Corpus corpus = GenerateCorpus(shape);
+
+            auto start = std::chrono::steady_clock::now();
+            const Document root = parse(corpus.text);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            if (!root.valid() || root.Get(corpus.paths.back()).node().type == NodeType::kNone) {
+                std::printf("unexpected parse result\n");
+                return;
+            }
+            double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            std::printf("%10zu %12.2f %12.1f\n", keys, ns / 1e6, ns / keys);
+        }
+    }
+
+    // Loads a section of numeric lookup tables and reads them back element by element
+    // and through the packed spans.
+    void BenchNumericTables() {
+        const size_t kTables = 1000;
+        const size_t kLength = 256;
+        std::mt19937 random(7);
+        std::string text = "[tables]\n";
+        for (size_t t = 0; t < kTables; t++) {
+            text += "table_" + std::to_string(t) + " = [";
+            for (size_t i = 0; i < kLength; i++) {
+                text += (i == 0 ? "" : ", ") + std::to_string(static_cast<int>(random() % 200000) - 100000);
+            }
+            text += "]\n";
+        }
+
+        PrintThroughput("tables", "parse(string)", text.size(), Measure([&] {
+            ParseAndDrop(text, {});
+        }));
+        const Document root = parse(text);
+        std::vector<Variable> tables;
+        for (size_t t = 0; t < kTables; t++) {
+            tables.push_back(root.Get("tables.table_" + std::to_string(t)));
+        }
+        int64_t sum = 0;
+        PrintLatency("tables", "sum, operator[]", kTables * kLength, Measure([&] {
+            for (const Variable& table : tables) {
+                for (size_t i = 0; i < table.Size(); i++) {
+                    sum += table[i].AsInt64();
+                }
+            }
+        }));
+        PrintLatency("tables", "sum, AsIntSpan", kTables * kLength, Measure([&] {
+            for (const Variable& table : tables) {
+                for (int64_t value : table.AsIntSpan()) {
+                    sum += value;
+                }
+            }
+        }));
+        if (sum == 0) {
+            std::printf("tables     sums came out empty\n");
+        }
+    }
+
+    bool Selected(int argc, char** argv, const char* name) {
+        if (argc <= 1) {
+            return true;
+        }
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+// Usage: bench [scaling] [tables] [wide] [deep] [arrays] [strings] [comments] [mixed]
+// Runs everything when no names are given.
+int main(int argc, char** argv) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "omfl_bench";
+    std::filesystem::create_directories(directory);
+
+    if (Selected(argc, argv, "scaling")) {
+        BenchWideSection();
+    }
+    if (Selected(argc, argv, "tables")) {
+        BenchNumericTables();
+    }
+    for (const NamedShape& shape : StandardShapes()) {
+        if (Selected(argc, argv, shape.name)) {
+            BenchShape(shape, directory);
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
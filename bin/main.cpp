@@ -1,8 +1,101 @@
 #include "lib/parser.h"
+#include "lib/transcode.h"
+#include "lib/writer.h"
+
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <vector>
 
 using namespace omfl;
 
-int main() {
+namespace {
+
+    // Converts through a parsed document, or straight from the text with `stream`. Every
+    // output gets the format its extension names, and one pass feeds all of them. opened
+    // is the number of outputs, from the first, that may have been truncated or written.
+    bool Convert(const std::filesystem::path& input, const std::vector<std::filesystem::path>& outputs, bool stream,
+                 size_t& opened) {
+        std::vector<ExportTarget> targets;
+        for (const std::filesystem::path& output : outputs) {
+            std::optional<Format> format = FormatOf(output);
+            if (!format) {
+                std::cerr << "unknown output format " << output.string() << '\n';
+                return false;
+            }
+            targets.push_back({*format, output});
+        }
+
+        if (stream) {
+            std::vector<std::unique_ptr<FileSink>> sinks;
+            std::vector<std::unique_ptr<Writer>> writers;
+            std::vector<Writer*> sink_writers;
+            for (const ExportTarget& target : targets) {
+                sinks.push_back(std::make_unique<FileSink>(target.path));
+                opened++;
+                if (!sinks.back()->good()) {
+                    std::cerr << "cannot write " << target.path.string() << '\n';
+                    return false;
+                }
+                writers.push_back(MakeWriter(target.format, *sinks.back()));
+                sink_writers.push_back(writers.back().get());
+            }
+            FanOutWriter writer(std::move(sink_writers));
+            if (!transcode(input, writer)) {
+                std::cerr << "invalid document " << input.string() << '\n';
+                return false;
+            }
+            bool written = true;
+            for (const std::unique_ptr<FileSink>& sink : sinks) {
+                written = sink->Close() && written;
+            }
+            if (!written) {
+                std::cerr << "cannot write the output files\n";
+            }
+            return written;
+        }
+
+        const Document root = parse(input);
+        for (const ParseError& error : root.errors()) {
+            // Errors about the file as a whole, such as an unreadable one, have no line.
+            if (error.line == 0) {
+                std::cerr << input.string() << ": " << ErrorKindName(error.kind) << '\n';
+                continue;
+            }
+            std::cerr << input.string() << ':' << error.line << ':' << error.column << ": "
+                      << ErrorKindName(error.kind) << ": " << error.text << '\n';
+        }
+        if (!root.valid()) {
+            return false;
+        }
+        opened = targets.size();
+        if (!root.Export(targets)) {
+            std::cerr << "cannot write the output files\n";
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        bool stream = std::strcmp(argv[1], "--stream") == 0;
+        if (argc < 3 + stream) {
+            std::cerr << "usage: " << argv[0] << " [--stream] <input.omfl> <output.json|yaml|xml>...\n";
+            return 2;
+        }
+        std::vector<std::filesystem::path> outputs(argv + 2 + stream, argv + argc);
+        size_t opened = 0;
+        if (!Convert(argv[1 + stream], outputs, stream, opened)) {
+            // Only what this run started writing is removed, never a file it left alone.
+            for (size_t i = 0; i < opened; i++) {
+                std::error_code error;
+                std::filesystem::remove(outputs[i], error);
+            }
+            return 1;
+        }
+        return 0;
+    }
 
     std::filesystem::path path("..\\..\\example\\config.omfl");
 
@@ -0,0 +1,34 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace omfl;
+
+void* Arena::AllocateSlow(size_t size, size_t align) {
+    size_t needed = size + align;
+    if (needed > next_block_size_ / 4) {
+        // Big requests get a block of their own so the current one keeps being used.
+        blocks_.emplace_back(new char[needed]);
+        bytes_reserved_ += needed;
+        auto address = reinterpret_cast<uintptr_t>(blocks_.back().get());
+        return blocks_.back().get() + (align - address % align) % align;
+    }
+
+    blocks_.emplace_back(new char[next_block_size_]);
+    bytes_reserved_ += next_block_size_;
+    current_ = blocks_.back().get();
+    left_ = next_block_size_;
+    next_block_size_ = std::min(next_block_size_ * 2, kMaxBlockSize);
+
+    return Allocate(size, align);
+}
+
+std::string_view Arena::CopyString(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    auto* data = static_cast<char*>(Allocate(str.size(), 1));
+    std::memcpy(data, str.data(), str.size());
+    return {data, str.size()};
+}
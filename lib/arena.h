@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace omfl {
+
+    // Bump allocator that owns every node, key and string of one parsed document.
+    // Nothing allocated here is freed individually: the blocks go away together with the arena.
+    class Arena {
+    private:
+
+        static constexpr size_t kMinBlockSize = 4 * 1024;
+        static constexpr size_t kMaxBlockSize = 1024 * 1024;
+
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        char* current_ = nullptr;
+        size_t left_ = 0;
+        size_t next_block_size_ = kMinBlockSize;
+        size_t bytes_reserved_ = 0;
+
+        std::shared_ptr<const void> source_owner_;
+        std::string_view source_;
+        std::vector<std::shared_ptr<const void>> held_;
+
+        void* AllocateSlow(size_t size, size_t align);
+
+    public:
+
+        Arena() = default;
+
+        Arena(const Arena&) = delete;
+
+        Arena& operator=(const Arena&) = delete;
+
+        void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+            size_t padding = (align - reinterpret_cast<uintptr_t>(current_) % align) % align;
+            if (padding + size > left_) {
+                return AllocateSlow(size, align);
+            }
+            char* result = current_ + padding;
+            current_ += padding + size;
+            left_ -= padding + size;
+            return result;
+        }
+
+        template<typename T, typename... Args>
+        T* Create(Args&& ... args) {
+            return new(Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template<typename T>
+        T* AllocateArray(size_t count) {
+            return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        std::string_view CopyString(std::string_view str);
+
+        // Keeps `owner` alive for the lifetime of the arena. Strings inside `bytes` are
+        // then handed out by Retain without copying.
+        void AttachSource(std::shared_ptr<const void> owner, std::string_view bytes) {
+            source_owner_ = std::move(owner);
+            source_ = bytes;
+        }
+
+        // Attaches the source of another arena to this one as well.
+        void ShareSource(const Arena& other) {
+            AttachSource(other.source_owner_, other.source_);
+        }
+
+        // Keeps `owner` alive for the lifetime of the arena, for nodes that point into
+        // memory owned by something else, such as another arena.
+        void Hold(std::shared_ptr<const void> owner) {
+            held_.push_back(std::move(owner));
+        }
+
+        // Returns a view of str that stays valid as long as the arena does.
+        std::string_view Retain(std::string_view str) {
+            auto begin = reinterpret_cast<uintptr_t>(str.data());
+            auto source_begin = reinterpret_cast<uintptr_t>(source_.data());
+            if (begin >= source_begin && begin + str.size() <= source_begin + source_.size()) {
+                return str;
+            }
+            return CopyString(str);
+        }
+
+        size_t BytesReserved() const {
+            return bytes_reserved_;
+        }
+
+    };
+
+    // Allocator for standard containers living inside an Arena. Deallocation is a no-op,
+    // so such containers never have to be destroyed.
+    template<typename T>
+    class ArenaAllocator {
+    private:
+
+        Arena* arena_;
+
+        template<typename U>
+        friend class ArenaAllocator;
+
+    public:
+
+        using value_type = T;
+
+        explicit ArenaAllocator(Arena& arena) : arena_(&arena) {
+        }
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena_) {
+        }
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T*, size_t) {
+        }
+
+        Arena& arena() const {
+            return *arena_;
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const {
+            return arena_ == other.arena_;
+        }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const {
+            return arena_ != other.arena_;
+        }
+
+    };
+
+    template<typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
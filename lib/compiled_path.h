@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "key_index.h"
+#include "node.h"
+
+
+namespace omfl {
+
+    // A dotted path split and hashed once, for lookups repeated many times.
+    // It does not refer to any document, so one instance can be shared between
+    // threads and reused across reloads.
+    //
+    // Every segment also remembers the position its name was found at among the members
+    // of its section. Documents with the same layout put a key at the same position, so
+    // a lookup first checks the key there and only searches the section when it differs.
+    // A path used again on the same document, or on a reload of it, then costs one key
+    // comparison per segment.
+    class CompiledPath {
+    private:
+
+        struct Segment {
+            uint32_t begin;
+            uint32_t size;
+            uint32_t hash;
+            // Relaxed: a stale or torn-between-threads hint only costs a search.
+            mutable std::atomic<uint32_t> position{0};
+
+            Segment(uint32_t begin, uint32_t size, uint32_t hash) : begin(begin), size(size), hash(hash) {
+            }
+
+            Segment(const Segment& other)
+                : begin(other.begin), size(other.size), hash(other.hash),
+                  position(other.position.load(std::memory_order_relaxed)) {
+            }
+
+            Segment& operator=(const Segment& other) {
+                begin = other.begin;
+                size = other.size;
+                hash = other.hash;
+                position.store(other.position.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                return *this;
+            }
+        };
+
+        std::string path_;
+        std::vector<Segment> segments_;
+
+    public:
+
+        explicit CompiledPath(std::string_view path) : path_(path) {
+            size_t begin = 0;
+            while (true) {
+                size_t dot = path_.find('.', begin);
+                size_t end = dot == std::string::npos ? path_.size() : dot;
+                std::string_view name = std::string_view(path_).substr(begin, end - begin);
+                segments_.push_back({static_cast<uint32_t>(begin), static_cast<uint32_t>(name.size()), HashKey(name)});
+                if (dot == std::string::npos) {
+                    break;
+                }
+                begin = dot + 1;
+            }
+        }
+
+        const std::string& path() const {
+            return path_;
+        }
+
+        size_t Size() const {
+            return segments_.size();
+        }
+
+        std::string_view Name(size_t i) const {
+            return std::string_view(path_).substr(segments_[i].begin, segments_[i].size);
+        }
+
+        uint32_t Hash(size_t i) const {
+            return segments_[i].hash;
+        }
+
+        // The node at this path below section, a tree with the given base, or nullptr.
+        const Node* Resolve(const Node& section, uintptr_t base) const {
+            const Node* node = &section;
+            for (size_t i = 0; i < segments_.size(); i++) {
+                if (node->type != NodeType::kSection) {
+                    return nullptr;
+                }
+                const Segment& segment = segments_[i];
+                std::string_view name = Name(i);
+                const Node* members = node->Body(base)->Members(base);
+                uint32_t position = segment.position.load(std::memory_order_relaxed);
+                if (position < node->size && members[position].Key(base) == name) {
+                    node = members + position;
+                    continue;
+                }
+                node = FindMember(*node, name, segment.hash, base);
+                if (node == nullptr) {
+                    return nullptr;
+                }
+                segment.position.store(static_cast<uint32_t>(node - members), std::memory_order_relaxed);
+            }
+            return node;
+        }
+
+    };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+namespace omfl {
+
+    enum class ErrorKind : uint8_t {
+        // A line that is neither a section header nor key = value.
+        kInvalidLine,
+        kInvalidSection,
+        kInvalidKey,
+        kMissingValue,
+        kInvalidValue,
+        kDuplicateKey,
+        // A section and a value of the same section share a name.
+        kSectionConflict,
+        kUnreadableFile,
+        // A value that does not fit the type it is bound to.
+        kTypeMismatch,
+        // Binary input that is cut short, is not a document or uses types OMFL lacks.
+        kMalformedData,
+        // A path bound to a member that the text does not have.
+        kMissingKey,
+    };
+
+    inline std::string_view ErrorKindName(ErrorKind kind) {
+        switch (kind) {
+            case ErrorKind::kInvalidLine:
+                return "invalid line";
+            case ErrorKind::kInvalidSection:
+                return "invalid section header";
+            case ErrorKind::kInvalidKey:
+                return "invalid key";
+            case ErrorKind::kMissingValue:
+                return "missing value";
+            case ErrorKind::kInvalidValue:
+                return "invalid value";
+            case ErrorKind::kDuplicateKey:
+                return "duplicate key";
+            case ErrorKind::kSectionConflict:
+                return "section conflicts with a value";
+            case ErrorKind::kUnreadableFile:
+                return "unreadable file";
+            case ErrorKind::kTypeMismatch:
+                return "type mismatch";
+            case ErrorKind::kMalformedData:
+                return "malformed data";
+            case ErrorKind::kMissingKey:
+                return "missing key";
+        }
+        return "unknown error";
+    }
+
+    // One problem of a document. Line and column count from 1, columns in bytes; both are
+    // 0 when the error has no place in a text, such as an unreadable file.
+    struct ParseError {
+        ErrorKind kind = ErrorKind::kInvalidLine;
+        size_t line = 0;
+        size_t column = 0;
+        // The offending part of the line.
+        std::string text;
+    };
+
+    // Turns positions in a text into lines and columns. Errors come in text order, so the
+    // newlines are counted on from the previous position instead of from the start, and
+    // nothing is counted at all for a text without errors.
+    class LineCounter {
+    private:
+
+        const char* text_ = nullptr;
+        size_t first_line_ = 1;
+        size_t offset_ = 0;
+        size_t line_ = 1;
+        size_t line_begin_ = 0;
+
+    public:
+
+        LineCounter() = default;
+
+        explicit LineCounter(std::string_view text, size_t first_line = 1)
+            : text_(text.data()), first_line_(first_line), line_(first_line) {
+        }
+
+        ParseError Locate(ErrorKind kind, std::string_view span) {
+            size_t position = span.data() - text_;
+            if (position < offset_) {
+                offset_ = 0;
+                line_ = first_line_;
+                line_begin_ = 0;
+            }
+            for (; offset_ < position; offset_++) {
+                if (text_[offset_] == '\n') {
+                    line_++;
+                    line_begin_ = offset_ + 1;
+                }
+            }
+
+            ParseError error;
+            error.kind = kind;
+            error.line = line_;
+            error.column = position - line_begin_ + 1;
+            error.text = span;
+            return error;
+        }
+
+    };
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "arena.h"
+
+
+namespace omfl {
+
+    inline uint32_t HashKey(std::string_view key) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : key) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    // Open-addressing hash table from key to its position in the owner's value list.
+    // Keys themselves are not stored: lookups compare against the owner's keys through key_at.
+    // Small owners are scanned linearly, the table is only built once they grow past kLinearLimit.
+    class KeyIndex {
+    public:
+
+        static constexpr size_t kLinearLimit = 8;
+        static constexpr uint32_t kNotFound = UINT32_MAX;
+
+    private:
+
+        struct Slot {
+            uint32_t hash;
+            uint32_t position;
+        };
+
+        static constexpr uint32_t kEmpty = UINT32_MAX;
+
+        // Address of the table relative to the base of the owning tree, 0 while there is
+        // no table. Tables are only built and grown in memory, where the base is 0.
+        uint64_t slots_ = 0;
+        uint32_t mask_ = 0;
+        uint32_t size_ = 0;
+
+        const Slot* SlotsAt(uintptr_t base) const {
+            return reinterpret_cast<const Slot*>(base + slots_);
+        }
+
+        void Place(uint32_t hash, uint32_t position) {
+            Slot* slots = reinterpret_cast<Slot*>(slots_);
+            uint32_t i = hash & mask_;
+            while (slots[i].position != kEmpty) {
+                i = (i + 1) & mask_;
+            }
+            slots[i] = {hash, position};
+        }
+
+        template<typename KeyAt>
+        void Grow(Arena& arena, KeyAt key_at) {
+            const Slot* old_slots = SlotsAt(0);
+            uint32_t old_capacity = TableSize();
+            uint32_t capacity = old_capacity == 0 ? kLinearLimit * 4 : old_capacity * 2;
+
+            auto* slots = static_cast<Slot*>(arena.Allocate(capacity * sizeof(Slot), alignof(Slot)));
+            for (uint32_t i = 0; i < capacity; i++) {
+                slots[i].position = kEmpty;
+            }
+            slots_ = reinterpret_cast<uintptr_t>(slots);
+            mask_ = capacity - 1;
+
+            if (old_capacity == 0) {
+                for (uint32_t position = 0; position < size_; position++) {
+                    Place(HashKey(key_at(position)), position);
+                }
+            } else {
+                for (uint32_t i = 0; i < old_capacity; i++) {
+                    if (old_slots[i].position != kEmpty) {
+                        Place(old_slots[i].hash, old_slots[i].position);
+                    }
+                }
+            }
+        }
+
+    public:
+
+        size_t Size() const {
+            return size_;
+        }
+
+        // Number of slots of the hash table, 0 while the owner is scanned linearly.
+        uint32_t TableSize() const {
+            return slots_ == 0 ? 0 : mask_ + 1;
+        }
+
+        size_t TableBytes() const {
+            return TableSize() * sizeof(Slot);
+        }
+
+        const void* Table(uintptr_t base) const {
+            return SlotsAt(base);
+        }
+
+        // Copy of this index with its own table in `arena`, for an owner built from a
+        // copy of this one's keys. base is the base of the tree this index belongs to.
+        KeyIndex CopyTo(Arena& arena, uintptr_t base) const {
+            KeyIndex copy = *this;
+            if (slots_ != 0) {
+                void* table = arena.Allocate(TableBytes(), alignof(Slot));
+                std::memcpy(table, SlotsAt(base), TableBytes());
+                copy.slots_ = reinterpret_cast<uintptr_t>(table);
+            }
+            return copy;
+        }
+
+        // Points the index at a copy of its table, for trees moved to another base.
+        void MoveTable(uint64_t slots) {
+            slots_ = slots;
+        }
+
+        // key_at(position) must return the key stored at that position of the owner.
+        // base is the base of the tree the index belongs to.
+        template<typename KeyAt>
+        uint32_t Find(std::string_view key, KeyAt key_at, uintptr_t base = 0) const {
+            if (slots_ == 0) {
+                for (uint32_t position = 0; position < size_; position++) {
+                    if (key_at(position) == key) {
+                        return position;
+                    }
+                }
+                return kNotFound;
+            }
+            return Find(key, HashKey(key), key_at, base);
+        }
+
+        // Same as above for a key whose HashKey is already known.
+        template<typename KeyAt>
+        uint32_t Find(std::string_view key, uint32_t hash, KeyAt key_at, uintptr_t base = 0) const {
+            if (slots_ == 0) {
+                return Find(key, key_at);
+            }
+            const Slot* slots = SlotsAt(base);
+            for (uint32_t i = hash & mask_; slots[i].position != kEmpty; i = (i + 1) & mask_) {
+                if (slots[i].hash == hash && key_at(slots[i].position) == key) {
+                    return slots[i].position;
+                }
+            }
+            return kNotFound;
+        }
+
+        // Number of keys a Find for key compares or slots it probes, for statistics.
+        template<typename KeyAt>
+        uint32_t Probes(std::string_view key, KeyAt key_at) const {
+            uint32_t probes = 0;
+            if (slots_ == 0) {
+                for (uint32_t position = 0; position < size_ && key_at(position) != key; position++) {
+                    probes++;
+                }
+                return probes + (probes < size_ ? 1 : 0);
+            }
+            uint32_t hash = HashKey(key);
+            const Slot* slots = SlotsAt(0);
+            for (uint32_t i = hash & mask_; slots[i].position != kEmpty; i = (i + 1) & mask_) {
+                probes++;
+                if (slots[i].hash == hash && key_at(slots[i].position) == key) {
+                    break;
+                }
+            }
+            return probes;
+        }
+
+        // Registers a key the owner has just appended at position Size().
+        template<typename KeyAt>
+        void Add(std::string_view key, Arena& arena, KeyAt key_at) {
+            uint32_t position = size_++;
+            if (slots_ == 0) {
+                if (size_ > kLinearLimit) {
+                    Grow(arena, key_at);
+                }
+                return;
+            }
+            if (size_ * 2 > mask_ + 1) {
+                Grow(arena, key_at);
+            }
+            Place(HashKey(key), position);
+        }
+
+    };
+}
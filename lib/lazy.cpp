@@ -0,0 +1,185 @@
+#include "lazy.h"
+
+#include "mapped_file.h"
+#include "scanner.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <tuple>
+
+using namespace omfl;
+
+namespace {
+
+    // A piece of the text and the top-level section it belongs to, empty for the keys
+    // before the first header.
+    struct Segment {
+        std::string_view name;
+        std::string_view run;
+    };
+
+    // Cuts the text into segments, each starting at a header. A malformed header line
+    // is left out of every segment, so the error is reported only once.
+    class SegmentBuilder {
+    private:
+
+        std::string_view text_;
+        LineCounter lines_;
+        std::vector<Segment>& segments_;
+        std::vector<ParseError>& errors_;
+        std::string_view name_;
+        size_t run_begin_ = 0;
+
+        // Ends the current segment at `end`.
+        void CloseRun(size_t end) {
+            if (end > run_begin_) {
+                segments_.push_back({name_, text_.substr(run_begin_, end - run_begin_)});
+            }
+        }
+
+    public:
+
+        SegmentBuilder(std::string_view text, std::vector<Segment>& segments, std::vector<ParseError>& errors)
+            : text_(text), lines_(text), segments_(segments), errors_(errors) {
+        }
+
+        void OnHeader(std::string_view path, size_t begin, size_t) {
+            CloseRun(begin);
+            name_ = path.substr(0, path.find('.'));
+            run_begin_ = begin;
+        }
+
+        void OnHeaderError(ErrorKind kind, std::string_view span, size_t begin, size_t end) {
+            errors_.push_back(lines_.Locate(kind, span));
+            CloseRun(begin);
+            run_begin_ = std::min(end + 1, text_.size());
+        }
+
+        bool Stopped() const {
+            return false;
+        }
+
+        void Build() {
+            HeaderScanner<SegmentBuilder>(*this).Scan(text_);
+            CloseRun(text_.size());
+        }
+
+    };
+}
+
+LazyDocument::LazyDocument(const std::string& code) {
+    auto text = std::make_shared<const std::string>(code);
+    text_ = *text;
+    owner_ = std::move(text);
+    Open();
+}
+
+LazyDocument::LazyDocument(const std::filesystem::path& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (!file->valid()) {
+        errors_.emplace_back();
+        errors_.back().kind = ErrorKind::kUnreadableFile;
+        return;
+    }
+    text_ = file->bytes();
+    owner_ = std::move(file);
+    Open();
+}
+
+void LazyDocument::Open() {
+    std::vector<Segment> segments;
+    SegmentBuilder(text_, segments, errors_).Build();
+
+    std::vector<std::string_view> root_runs;
+    auto key_at = [this](size_t i) { return units_[i].name; };
+    for (const Segment& segment : segments) {
+        if (segment.name.empty()) {
+            root_runs.push_back(segment.run);
+            continue;
+        }
+        uint32_t position = index_.Find(segment.name, key_at);
+        if (position == KeyIndex::kNotFound) {
+            position = static_cast<uint32_t>(units_.size());
+            units_.emplace_back();
+            units_.back().name = segment.name;
+            index_.Add(segment.name, arena_, key_at);
+        }
+        std::vector<std::string_view>& runs = units_[position].runs;
+        if (!runs.empty() && runs.back().data() + runs.back().size() == segment.run.data()) {
+            runs.back() = std::string_view(runs.back().data(), runs.back().size() + segment.run.size());
+        } else {
+            runs.push_back(segment.run);
+        }
+    }
+
+    root_ = parse_runs(text_, root_runs, owner_);
+    AddErrors(root_.errors());
+    // A full parse finds these when it opens the section; the keys are all known by now.
+    const Node& root = root_.node();
+    const Node* members = root.Body(root_.base())->Members(root_.base());
+    LineCounter lines(text_);
+    for (size_t i = 0; i < root.size; i++) {
+        if (Unit* unit = FindUnit(members[i].Key(root_.base()))) {
+            errors_.push_back(lines.Locate(ErrorKind::kSectionConflict, unit->name));
+        }
+    }
+}
+
+void LazyDocument::AddErrors(const std::vector<ParseError>& errors) const {
+    if (errors.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    errors_.insert(errors_.end(), errors.begin(), errors.end());
+}
+
+LazyDocument::Unit* LazyDocument::FindUnit(std::string_view name) const {
+    uint32_t position = index_.Find(name, [this](size_t i) { return units_[i].name; });
+    return position == KeyIndex::kNotFound ? nullptr : &units_[position];
+}
+
+LazyDocument::Unit* LazyDocument::FindUnit(std::string_view name, uint32_t hash) const {
+    uint32_t position = index_.Find(name, hash, [this](size_t i) { return units_[i].name; });
+    return position == KeyIndex::kNotFound ? nullptr : &units_[position];
+}
+
+const Document& LazyDocument::Parsed(Unit& unit) const {
+    std::call_once(unit.parsed, [this, &unit] {
+        unit.document = parse_runs(text_, unit.runs, owner_);
+        AddErrors(unit.document.errors());
+    });
+    return unit.document;
+}
+
+Variable LazyDocument::Get(std::string_view path) const {
+    if (Unit* unit = FindUnit(path.substr(0, path.find('.')))) {
+        return Parsed(*unit).Get(path);
+    }
+    return root_.Get(path);
+}
+
+Variable LazyDocument::Get(const CompiledPath& path) const {
+    if (path.Size() != 0) {
+        if (Unit* unit = FindUnit(path.Name(0), path.Hash(0))) {
+            return Parsed(*unit).Get(path);
+        }
+    }
+    return root_.Get(path);
+}
+
+bool LazyDocument::valid() const {
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    return errors_.empty();
+}
+
+std::vector<ParseError> LazyDocument::errors() const {
+    std::vector<ParseError> errors;
+    {
+        std::lock_guard<std::mutex> lock(errors_mutex_);
+        errors = errors_;
+    }
+    std::stable_sort(errors.begin(), errors.end(), [](const ParseError& a, const ParseError& b) {
+        return std::tie(a.line, a.column) < std::tie(b.line, b.column);
+    });
+    return errors;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+
+namespace omfl {
+
+    // A document whose top-level sections are parsed the first time Get reads them.
+    // Opening it only tokenizes the section headers and the keys before the first one;
+    // every other line is left alone until its section is needed, so the time and memory
+    // a process spends on the document follow the sections it reads rather than the size
+    // of the text. Get can be called from any number of threads.
+    //
+    // A section is parsed together with all of its subsections, into the same tree a
+    // full parse would build for it. The text has to stay unchanged while the document
+    // lives: a file is read through a memory mapping.
+    class LazyDocument {
+    private:
+
+        struct Unit {
+            std::string_view name;
+            // Pieces of the text with the headers and values of this section, in text order.
+            std::vector<std::string_view> runs;
+            std::once_flag parsed;
+            Document document;
+        };
+
+        std::shared_ptr<const void> owner_;
+        std::string_view text_;
+
+        // Top-level sections by name.
+        Arena arena_;
+        KeyIndex index_;
+        mutable std::deque<Unit> units_;
+        // Keys before the first header.
+        Document root_;
+
+        mutable std::mutex errors_mutex_;
+        mutable std::vector<ParseError> errors_;
+
+        void Open();
+
+        void AddErrors(const std::vector<ParseError>& errors) const;
+
+        Unit* FindUnit(std::string_view name) const;
+
+        Unit* FindUnit(std::string_view name, uint32_t hash) const;
+
+        // The document of unit, parsed by the first caller. Others wait until it is done.
+        const Document& Parsed(Unit& unit) const;
+
+    public:
+
+        explicit LazyDocument(const std::string& code);
+
+        explicit LazyDocument(const std::filesystem::path& path);
+
+        LazyDocument(const LazyDocument&) = delete;
+
+        LazyDocument& operator=(const LazyDocument&) = delete;
+
+        Variable Get(std::string_view path) const;
+
+        Variable Get(const CompiledPath& path) const;
+
+        // Whether no error has been found so far. Sections nobody has read are not checked.
+        bool valid() const;
+
+        // Errors found so far in text order: those of the headers and the keys before the
+        // first header, and those of every section read since.
+        std::vector<ParseError> errors() const;
+
+    };
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+
+namespace omfl {
+
+    // Read-only memory mapping of a whole file.
+    class MappedFile {
+    private:
+
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        bool valid_ = false;
+
+#ifdef _WIN32
+        void* file_ = nullptr;
+        void* mapping_ = nullptr;
+#endif
+
+    public:
+
+        // `sequential` tells the OS the file will be read front to back once.
+        explicit MappedFile(const std::filesystem::path& path, bool sequential = true);
+
+        MappedFile(const MappedFile&) = delete;
+
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        bool valid() const {
+            return valid_;
+        }
+
+        std::string_view bytes() const {
+            return {data_, size_};
+        }
+
+    };
+}
@@ -0,0 +1,301 @@
+#include "msgpack.h"
+
+#include "mapped_file.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+using namespace omfl;
+
+namespace omfl {
+
+    // Decodes MessagePack straight into the nodes of a document, which are only
+    // published as its tree once the whole input has been read.
+    class MsgPackReader {
+    private:
+
+        // Deepest nesting of maps and arrays accepted, so hostile input cannot exhaust the stack.
+        static constexpr size_t kMaxDepth = 1024;
+
+        Document& document_;
+        Arena& arena_;
+        std::string_view bytes_;
+        size_t position_ = 0;
+        size_t depth_ = 0;
+        // Elements of the arrays being read, by depth.
+        std::vector<std::vector<Node>> arrays_;
+
+        bool Fail(ErrorKind kind, std::string_view text = {}) {
+            ParseError error;
+            error.kind = kind;
+            error.text = text;
+            document_.valid_ = false;
+            document_.errors_.push_back(std::move(error));
+            return false;
+        }
+
+        bool Take(size_t size, std::string_view& bytes) {
+            if (bytes_.size() - position_ < size) {
+                return Fail(ErrorKind::kMalformedData);
+            }
+            bytes = bytes_.substr(position_, size);
+            position_ += size;
+            return true;
+        }
+
+        template<typename T>
+        bool ReadBigEndian(T& value) {
+            std::string_view bytes;
+            if (!Take(sizeof(T), bytes)) {
+                return false;
+            }
+            value = 0;
+            for (char byte : bytes) {
+                value = static_cast<T>(value << 8 | static_cast<uint8_t>(byte));
+            }
+            return true;
+        }
+
+        // Reads the count of `width` bytes that follows the type byte of a str, array
+        // or map. Every item takes at least min_item_size bytes, so a count that cannot
+        // fit in the rest of the input is refused before anything is allocated for it.
+        bool ReadCount(size_t width, uint32_t& count, size_t min_item_size) {
+            std::string_view bytes;
+            if (!Take(width, bytes)) {
+                return false;
+            }
+            count = 0;
+            for (char byte : bytes) {
+                count = count << 8 | static_cast<uint8_t>(byte);
+            }
+            if ((bytes_.size() - position_) / min_item_size < count) {
+                return Fail(ErrorKind::kMalformedData);
+            }
+            return true;
+        }
+
+        bool ReadString(uint8_t type, std::string_view& value) {
+            uint32_t length = type & 0x1f;
+            if (type >= 0xd9 && type <= 0xdb && !ReadCount(size_t(1) << (type - 0xd9), length, 1)) {
+                return false;
+            }
+            return Take(length, value);
+        }
+
+        bool ReadMap(Node& node, uint32_t count) {
+            Node* members = arena_.AllocateArray<Node>(count);
+            KeyIndex index;
+            auto key_at = [members](size_t i) { return members[i].Key(0); };
+            for (uint32_t i = 0; i < count; i++) {
+                std::string_view key;
+                uint8_t type = 0;
+                if (!ReadType(type)) {
+                    return false;
+                }
+                if (!((type >= 0xa0 && type <= 0xbf) || (type >= 0xd9 && type <= 0xdb))) {
+                    return Fail(ErrorKind::kMalformedData);
+                }
+                if (!ReadString(type, key)) {
+                    return false;
+                }
+                if (key.empty() || !std::all_of(key.begin(), key.end(), IsKeyChar)) {
+                    return Fail(ErrorKind::kInvalidKey, key);
+                }
+                if (index.Find(key, key_at) != KeyIndex::kNotFound) {
+                    return Fail(ErrorKind::kDuplicateKey, key);
+                }
+                members[i] = Node();
+                members[i].SetKey(arena_.CopyString(key));
+                index.Add(members[i].Key(0), arena_, key_at);
+                if (!ReadValue(members[i], false)) {
+                    return false;
+                }
+            }
+
+            auto* body = arena_.Create<SectionBody>();
+            body->members = reinterpret_cast<uintptr_t>(members);
+            body->index = index;
+            node.type = NodeType::kSection;
+            node.size = count;
+            node.SetPayload(body);
+            return true;
+        }
+
+        bool ReadArray(Node& node, uint32_t count) {
+            // depth_ already counts this array. The elements are gathered in arrays_ and
+            // only then copied out, packed if they can be.
+            size_t level = depth_ - 1;
+            if (level >= arrays_.size()) {
+                arrays_.resize(level + 1);
+            }
+            arrays_[level].clear();
+            for (uint32_t i = 0; i < count; i++) {
+                Node element;
+                if (!ReadValue(element, true)) {
+                    return false;
+                }
+                arrays_[level].push_back(element);
+            }
+            SetArray(node, arrays_[level].data(), count, arena_);
+            return true;
+        }
+
+        bool ReadType(uint8_t& type) {
+            std::string_view bytes;
+            if (!Take(1, bytes)) {
+                return false;
+            }
+            type = static_cast<uint8_t>(bytes[0]);
+            return true;
+        }
+
+        template<typename T>
+        bool ReadInt(Node& node) {
+            std::make_unsigned_t<T> bits;
+            if (!ReadBigEndian(bits)) {
+                return false;
+            }
+            if constexpr (std::is_same_v<T, uint64_t>) {
+                if (bits > static_cast<uint64_t>(INT64_MAX)) {
+                    return Fail(ErrorKind::kMalformedData);
+                }
+            }
+            node.type = NodeType::kInt;
+            node.int_value = static_cast<T>(bits);
+            return true;
+        }
+
+        // Reads one value into node without touching its key. in_array forbids maps.
+        bool ReadValue(Node& node, bool in_array) {
+            uint8_t type = 0;
+            if (!ReadType(type)) {
+                return false;
+            }
+            if (type <= 0x7f || type >= 0xe0) {
+                node.type = NodeType::kInt;
+                node.int_value = static_cast<int8_t>(type);
+                return true;
+            }
+            if ((type >= 0xa0 && type <= 0xbf) || (type >= 0xd9 && type <= 0xdb)) {
+                std::string_view value;
+                if (!ReadString(type, value)) {
+                    return false;
+                }
+                node.type = NodeType::kString;
+                node.size = static_cast<uint32_t>(value.size());
+                node.SetPayload(arena_.CopyString(value).data());
+                return true;
+            }
+
+            bool is_map = (type >= 0x80 && type <= 0x8f) || type == 0xde || type == 0xdf;
+            bool is_array = (type >= 0x90 && type <= 0x9f) || type == 0xdc || type == 0xdd;
+            if (is_map || is_array) {
+                if ((is_map && in_array) || depth_ == kMaxDepth) {
+                    return Fail(ErrorKind::kMalformedData);
+                }
+                uint32_t count = type & 0x0f;
+                if (type >= 0xdc && !ReadCount(type == 0xdc || type == 0xde ? 2 : 4, count, is_map ? 2 : 1)) {
+                    return false;
+                }
+                depth_++;
+                bool read = is_map ? ReadMap(node, count) : ReadArray(node, count);
+                depth_--;
+                return read;
+            }
+
+            switch (type) {
+                case 0xc2:
+                case 0xc3:
+                    node.type = NodeType::kBool;
+                    node.bool_value = type == 0xc3;
+                    return true;
+                case 0xca: {
+                    uint32_t bits;
+                    if (!ReadBigEndian(bits)) {
+                        return false;
+                    }
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    node.type = NodeType::kFloat;
+                    node.float_value = value;
+                    return true;
+                }
+                case 0xcb: {
+                    uint64_t bits;
+                    if (!ReadBigEndian(bits)) {
+                        return false;
+                    }
+                    node.type = NodeType::kFloat;
+                    std::memcpy(&node.float_value, &bits, sizeof(bits));
+                    return true;
+                }
+                case 0xcc:
+                    return ReadInt<uint8_t>(node);
+                case 0xcd:
+                    return ReadInt<uint16_t>(node);
+                case 0xce:
+                    return ReadInt<uint32_t>(node);
+                case 0xcf:
+                    return ReadInt<uint64_t>(node);
+                case 0xd0:
+                    return ReadInt<int8_t>(node);
+                case 0xd1:
+                    return ReadInt<int16_t>(node);
+                case 0xd2:
+                    return ReadInt<int32_t>(node);
+                case 0xd3:
+                    return ReadInt<int64_t>(node);
+                default:
+                    return Fail(ErrorKind::kMalformedData);
+            }
+        }
+
+    public:
+
+        explicit MsgPackReader(Document& document) : document_(document), arena_(*document.arena_owner_) {
+        }
+
+        void Read(std::string_view bytes) {
+            bytes_ = bytes;
+            auto type = static_cast<uint8_t>(bytes_.empty() ? 0 : bytes_[0]);
+            if (!((type >= 0x80 && type <= 0x8f) || type == 0xde || type == 0xdf)) {
+                Fail(ErrorKind::kMalformedData);
+                return;
+            }
+            Node root;
+            if (!ReadValue(root, false)) {
+                return;
+            }
+            if (position_ != bytes_.size()) {
+                Fail(ErrorKind::kMalformedData);
+                return;
+            }
+            document_.node_ = arena_.Create<Node>(root);
+        }
+
+        void ReadFile(const std::filesystem::path& path) {
+            MappedFile file(path);
+            if (!file.valid()) {
+                Fail(ErrorKind::kUnreadableFile);
+                return;
+            }
+            Read(file.bytes());
+        }
+
+    };
+}
+
+Document omfl::load_msgpack(const std::string& bytes) {
+    Document document;
+    MsgPackReader(document).Read(bytes);
+    return document;
+}
+
+Document omfl::load_msgpack(const std::filesystem::path& path) {
+    Document document;
+    MsgPackReader(document).ReadFile(path);
+    return document;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "parser.h"
+
+
+namespace omfl {
+
+    // Reads a document written by Section::WriteMsgPack, or any MessagePack map whose
+    // contents OMFL can hold: maps become sections, keys must be valid OMFL keys and
+    // arrays cannot contain maps. Nil, binary and extension types are not supported.
+    // Strings are copied, so the bytes do not have to outlive the document. Input that
+    // does not fit gives an invalid document with a single error and an empty tree.
+    Document load_msgpack(const std::string& bytes);
+
+    Document load_msgpack(const std::filesystem::path& path);
+}
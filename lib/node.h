@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "arena.h"
+#include "key_index.h"
+
+
+namespace omfl {
+
+    enum class NodeType : uint8_t {
+        kNone,
+        kInt,
+        kFloat,
+        kString,
+        kBool,
+        kArray,
+        kSection,
+    };
+
+    struct SectionBody;
+
+    // One value of a parsed document: a type tag and a payload, 32 bytes in total.
+    // Section members and the elements of mixed arrays are stored as contiguous runs of
+    // nodes. An array whose elements are all ints, all floats or all bools is packed
+    // instead: a plain run of int64_t, double or bool values.
+    //
+    // The key and the payload of strings, arrays and sections are addresses relative to
+    // the base of the tree they belong to. Trees built in memory have base 0, so these
+    // are plain addresses there; a snapshot image uses the address it is mapped at, which
+    // lets it be read in place wherever it lands.
+    struct Node {
+        NodeType type = NodeType::kNone;
+        // Type of every element of a packed array, kNone for any other node.
+        NodeType packed = NodeType::kNone;
+        // Length of a string, number of array elements or section members.
+        uint32_t size = 0;
+        uint32_t key_size = 0;
+        uint64_t key = 0;
+        union {
+            int64_t int_value = 0;
+            double float_value;
+            bool bool_value;
+            uint64_t offset;
+        };
+
+        std::string_view Key(uintptr_t base) const {
+            return {reinterpret_cast<const char*>(base + key), key_size};
+        }
+
+        std::string_view String(uintptr_t base) const {
+            return {reinterpret_cast<const char*>(base + offset), size};
+        }
+
+        const Node* Elements(uintptr_t base) const {
+            return reinterpret_cast<const Node*>(base + offset);
+        }
+
+        const int64_t* Ints(uintptr_t base) const {
+            return reinterpret_cast<const int64_t*>(base + offset);
+        }
+
+        const double* Floats(uintptr_t base) const {
+            return reinterpret_cast<const double*>(base + offset);
+        }
+
+        const bool* Bools(uintptr_t base) const {
+            return reinterpret_cast<const bool*>(base + offset);
+        }
+
+        // Bytes taken by the elements of a packed array.
+        size_t PackedBytes() const {
+            return size * (packed == NodeType::kBool ? sizeof(bool) : sizeof(int64_t));
+        }
+
+        const SectionBody* Body(uintptr_t base) const {
+            return reinterpret_cast<const SectionBody*>(base + offset);
+        }
+
+        // Setters for trees built in memory.
+        void SetKey(std::string_view value) {
+            key = reinterpret_cast<uintptr_t>(value.data());
+            key_size = static_cast<uint32_t>(value.size());
+        }
+
+        void SetPayload(const void* payload) {
+            offset = reinterpret_cast<uintptr_t>(payload);
+        }
+    };
+
+    static_assert(sizeof(Node) == 32);
+
+    // Makes node an array of the given elements, copied into arena: packed when they all
+    // have the same scalar type, as nodes otherwise.
+    inline void SetArray(Node& node, const Node* elements, size_t count, Arena& arena) {
+        node.type = NodeType::kArray;
+        node.packed = NodeType::kNone;
+        node.size = static_cast<uint32_t>(count);
+        NodeType type = count == 0 ? NodeType::kNone : elements[0].type;
+        bool scalar = type == NodeType::kInt || type == NodeType::kFloat || type == NodeType::kBool;
+        for (size_t i = 1; i < count && scalar; i++) {
+            scalar = elements[i].type == type;
+        }
+        if (!scalar) {
+            Node* copy = arena.AllocateArray<Node>(count);
+            std::copy(elements, elements + count, copy);
+            node.SetPayload(copy);
+            return;
+        }
+
+        node.packed = type;
+        if (type == NodeType::kBool) {
+            bool* values = arena.AllocateArray<bool>(count);
+            for (size_t i = 0; i < count; i++) {
+                values[i] = elements[i].bool_value;
+            }
+            node.SetPayload(values);
+        } else if (type == NodeType::kInt) {
+            auto* values = arena.AllocateArray<int64_t>(count);
+            for (size_t i = 0; i < count; i++) {
+                values[i] = elements[i].int_value;
+            }
+            node.SetPayload(values);
+        } else {
+            auto* values = arena.AllocateArray<double>(count);
+            for (size_t i = 0; i < count; i++) {
+                values[i] = elements[i].float_value;
+            }
+            node.SetPayload(values);
+        }
+    }
+
+    struct SectionBody {
+        uint64_t members = 0;
+        KeyIndex index;
+
+        const Node* Members(uintptr_t base) const {
+            return reinterpret_cast<const Node*>(base + members);
+        }
+    };
+
+    inline const Node* FindMember(const Node& section, std::string_view key, uintptr_t base = 0) {
+        if (section.type != NodeType::kSection) {
+            return nullptr;
+        }
+        const SectionBody* body = section.Body(base);
+        const Node* members = body->Members(base);
+        uint32_t position = body->index.Find(key, [members, base](size_t i) { return members[i].Key(base); }, base);
+        return position == KeyIndex::kNotFound ? nullptr : members + position;
+    }
+
+    inline const Node* FindMember(const Node& section, std::string_view key, uint32_t hash, uintptr_t base) {
+        if (section.type != NodeType::kSection) {
+            return nullptr;
+        }
+        const SectionBody* body = section.Body(base);
+        const Node* members = body->Members(base);
+        uint32_t position = body->index.Find(key, hash, [members, base](size_t i) { return members[i].Key(base); }, base);
+        return position == KeyIndex::kNotFound ? nullptr : members + position;
+    }
+}
@@ -0,0 +1,108 @@
+#include "output.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace omfl;
+
+// Binary mode, so MessagePack reaches the file as written and the text formats end
+// their lines with \n on every platform.
+FileSink::FileSink(const std::filesystem::path& path) : owned_(true) {
+#ifdef _WIN32
+    file_ = _wfopen(path.c_str(), L"wb");
+#else
+    file_ = std::fopen(path.c_str(), "wb");
+#endif
+    good_ = file_ != nullptr;
+}
+
+FileSink::~FileSink() {
+    Close();
+}
+
+bool FileSink::Close() {
+    if (file_ == nullptr) {
+        return good_;
+    }
+    if (std::fflush(file_) != 0) {
+        good_ = false;
+    }
+    if (owned_) {
+        if (std::fclose(file_) != 0) {
+            good_ = false;
+        }
+        file_ = nullptr;
+    }
+    return good_;
+}
+
+void FileSink::Write(const char* data, size_t size) {
+    if (good_ && file_ != nullptr && std::fwrite(data, 1, size, file_) != size) {
+        good_ = false;
+    }
+}
+
+void FdSink::Write(const char* data, size_t size) {
+    while (good_ && size > 0) {
+#ifdef _WIN32
+        int written = _write(fd_, data, static_cast<unsigned>(size));
+#else
+        ssize_t written = ::write(fd_, data, size);
+#endif
+        if (written < 0) {
+            good_ = errno == EINTR;
+            continue;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+void OutputBuffer::PutSlow(std::string_view text) {
+    Flush();
+    if (text.size() >= kCapacity) {
+        sink_.Write(text.data(), text.size());
+        return;
+    }
+    std::memcpy(data_.get(), text.data(), text.size());
+    size_ = text.size();
+}
+
+void OutputBuffer::PutRepeated(char c, size_t count) {
+    while (count > 0) {
+        if (size_ == kCapacity) {
+            Flush();
+        }
+        size_t chunk = std::min(count, kCapacity - size_);
+        std::memset(data_.get() + size_, c, chunk);
+        size_ += chunk;
+        count -= chunk;
+    }
+}
+
+void OutputBuffer::PutInt(int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    Put(std::string_view(digits, result.ptr - digits));
+}
+
+void OutputBuffer::PutDouble(double value) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general);
+    Put(std::string_view(digits, result.ptr - digits));
+}
+
+void OutputBuffer::Flush() {
+    if (size_ != 0) {
+        sink_.Write(data_.get(), size_);
+        size_ = 0;
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+
+namespace omfl {
+
+    // Destination of serialized bytes. Writers never call it for less than a full
+    // buffer unless they are flushing, so a sink may be as slow as a system call.
+    class OutputSink {
+    public:
+
+        virtual ~OutputSink() = default;
+
+        virtual void Write(const char* data, size_t size) = 0;
+
+    };
+
+    class StringSink : public OutputSink {
+    private:
+
+        std::string& output_;
+
+    public:
+
+        explicit StringSink(std::string& output) : output_(output) {
+        }
+
+        void Write(const char* data, size_t size) override {
+            output_.append(data, size);
+        }
+
+    };
+
+    // Writes to a stdio stream, either borrowed or opened from a path and owned.
+    class FileSink : public OutputSink {
+    private:
+
+        std::FILE* file_ = nullptr;
+        bool owned_ = false;
+        bool good_ = false;
+
+    public:
+
+        explicit FileSink(std::FILE* file) : file_(file), good_(file != nullptr) {
+        }
+
+        explicit FileSink(const std::filesystem::path& path);
+
+        FileSink(const FileSink&) = delete;
+
+        FileSink& operator=(const FileSink&) = delete;
+
+        ~FileSink() override;
+
+        // False once opening, any write or closing has failed.
+        bool good() const {
+            return good_;
+        }
+
+        void Write(const char* data, size_t size) override;
+
+        // Flushes the stream and closes it if it is owned. stdio keeps the last bytes
+        // written in its own buffer, so only after this does good() say whether all of
+        // them reached the file. Returns good().
+        bool Close();
+
+    };
+
+    // Writes to a raw file descriptor, which stays owned by the caller.
+    class FdSink : public OutputSink {
+    private:
+
+        int fd_;
+        bool good_ = true;
+
+    public:
+
+        explicit FdSink(int fd) : fd_(fd) {
+        }
+
+        bool good() const {
+            return good_;
+        }
+
+        void Write(const char* data, size_t size) override;
+
+    };
+
+    class CallbackSink : public OutputSink {
+    private:
+
+        std::function<void(std::string_view)> callback_;
+
+    public:
+
+        explicit CallbackSink(std::function<void(std::string_view)> callback) : callback_(std::move(callback)) {
+        }
+
+        void Write(const char* data, size_t size) override {
+            callback_(std::string_view(data, size));
+        }
+
+    };
+
+    // Fixed-size buffer in front of a sink. Everything is appended with memcpy and
+    // numbers are formatted with std::to_chars straight into the buffer.
+    class OutputBuffer {
+    private:
+
+        static constexpr size_t kCapacity = 1 << 16;
+
+        OutputSink& sink_;
+        std::unique_ptr<char[]> data_;
+        size_t size_ = 0;
+
+        void PutSlow(std::string_view text);
+
+    public:
+
+        explicit OutputBuffer(OutputSink& sink) : sink_(sink), data_(new char[kCapacity]) {
+        }
+
+        OutputBuffer(const OutputBuffer&) = delete;
+
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        ~OutputBuffer() {
+            Flush();
+        }
+
+        void Put(char c) {
+            if (size_ == kCapacity) {
+                Flush();
+            }
+            data_[size_++] = c;
+        }
+
+        void Put(std::string_view text) {
+            if (text.size() > kCapacity - size_) {
+                PutSlow(text);
+                return;
+            }
+            std::char_traits<char>::copy(data_.get() + size_, text.data(), text.size());
+            size_ += text.size();
+        }
+
+        // Appends `count` copies of c at once, for indentation.
+        void PutRepeated(char c, size_t count);
+
+        void PutInt(int64_t value);
+
+        // Shortest representation that reads back as the same double.
+        void PutDouble(double value);
+
+        void Flush();
+
+    };
+}
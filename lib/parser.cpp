@@ -1,403 +1,729 @@
 #include "parser.h"
+#include "mapped_file.h"
+#include "query.h"
+#include "scanner.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+#include "writer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iterator>
 
 using namespace omfl;
 
-Variable empty_var;
+namespace omfl {
 
-Section* current_section = nullptr;
+    // Mutable state of a single parse call. Keeping it here instead of in globals
+    // lets any number of documents be parsed concurrently.
+    class Parser {
+    private:
 
-Variable& Variable::operator[](size_t index) const {
-    return empty_var;
+        // Smallest piece of a document worth handing to another thread.
+        static constexpr size_t kMinChunkSize = 1 << 20;
+
+        // Members of a section while the document is being built. A section can be
+        // reopened by a later header, so its members only become one contiguous run of
+        // nodes in Freeze. Until then a member section node keeps the index of its
+        // builder in `size`.
+        struct SectionBuilder {
+            std::vector<Node> members;
+            KeyIndex index;
+        };
+
+        Section& root_;
+        Arena& arena_;
+        std::deque<SectionBuilder> sections_;
+        SectionBuilder* current_section_;
+
+        // Key of the value being parsed and the elements of the arrays it has opened and
+        // not yet closed. The vectors are kept between values to reuse their storage.
+        std::string_view pending_key_;
+        std::vector<std::vector<Node>> arrays_;
+        size_t depth_ = 0;
+
+        // Places errors in the text being parsed.
+        LineCounter lines_;
+        bool stop_at_first_error_ = false;
+
+        friend class Tokenizer<Parser>;
+
+        uint32_t FindMember(const SectionBuilder& section, std::string_view key) const;
+
+        void AddMember(SectionBuilder& section, const Node& node);
+
+        // Returns the child section `name` of `parent`, creating it if needed,
+        // or nullptr if the name is empty or already taken by a value.
+        SectionBuilder* OpenSection(SectionBuilder& parent, std::string_view name);
+
+        // Records an error at span, a view of the text being parsed.
+        void Error(ErrorKind kind, std::string_view span);
+
+        // Records an error that has no place in a text: a clash found while merging
+        // or an unreadable file.
+        void UnplacedError(ErrorKind kind, std::string_view key);
+
+        // Adds a finished value to the innermost open array, or to the current section
+        // under the pending key when no array is open.
+        void Emit(Node node);
+
+        // Tokenizer events.
+        void OnSection(std::string_view path);
+
+        bool OnKey(std::string_view key);
+
+        void OnInt(int64_t value);
+
+        void OnFloat(double value);
+
+        void OnBool(bool value);
+
+        void OnString(std::string_view value);
+
+        void OnArrayBegin();
+
+        void OnArrayEnd();
+
+        void OnError(ErrorKind kind, std::string_view span);
+
+        bool Stopped() const {
+            return stop_at_first_error_ && !root_.valid_;
+        }
+
+        // Adds the members of `section`, a section of another document, to `target` with
+        // the same checks ParseLine would have made.
+        void MergeSection(SectionBuilder& target, const Node& section, uintptr_t base);
+
+        // Copy of a node of a tree with the given base that is valid in this one.
+        Node Rebase(const Node& node, uintptr_t base);
+
+        // Moves the members of a builder into the arena as one contiguous run.
+        const SectionBody* Freeze(SectionBuilder& section);
+
+    public:
+
+        explicit Parser(Section& root)
+            : root_(root), arena_(*root.arena_owner_), sections_(1), current_section_(&sections_.front()) {
+        }
+
+        void ParseText(std::string_view text);
+
+        // ParseText for pieces of text fed one after another. owner keeps text alive.
+        void ParseRuns(std::string_view text, const std::vector<std::string_view>& runs,
+                       std::shared_ptr<const void> owner);
+
+        // Cuts text at section headers into `chunks` pieces, parses them into separate
+        // documents on `threads` workers and merges those in order.
+        void ParseChunks(std::string_view text, size_t chunks, size_t threads);
+
+        // ParseText, or ParseChunks when options.threads allows it and text is big enough.
+        // Pieces cannot tell where they clash with each other, so an invalid document is
+        // parsed again on one thread to report its errors in text order.
+        void Parse(std::string_view text, const ParseOptions& options);
+
+        void ParseFile(const std::filesystem::path& path, const ParseOptions& options);
+
+        // Continues the document with a piece parsed on its own. The piece stays alive
+        // as long as the document does.
+        void Merge(const Section& piece);
+
+        // Publishes the built tree as the root of the document.
+        void Finish();
+
+    };
 }
 
-Variable& Array::operator[](size_t index) const {
-    if (index < values_.size()) {
-        return *values_[index];
+Section::Section() : arena_owner_(std::make_shared<Arena>()) {
+    auto* root = arena_owner_->Create<Node>();
+    root->type = NodeType::kSection;
+    root->SetPayload(arena_owner_->Create<SectionBody>());
+    node_ = root;
+}
+
+Variable Variable::Get(std::string_view path) const {
+    const Node* node = node_;
+    while (true) {
+        size_t dot = path.find('.');
+        node = FindMember(*node, path.substr(0, dot), base_);
+        if (node == nullptr) {
+            return {};
+        }
+        if (dot == std::string_view::npos) {
+            return Variable(node, base_);
+        }
+        path.remove_prefix(dot + 1);
     }
-    return empty_var;
 }
 
-Variable& Variable::Get(std::string_view path) const {
-    return empty_var;
+uint32_t Parser::FindMember(const SectionBuilder& section, std::string_view key) const {
+    auto key_at = [&section](size_t i) { return section.members[i].Key(0); };
+    OMFL_STATS(
+        uint32_t& longest = root_.stats_.longest_find_scan;
+        longest = std::max(longest, section.index.Probes(key, key_at));
+    )
+    return section.index.Find(key, key_at);
 }
 
-Variable& Section::Get(std::string_view path) const {
-    size_t dot = path.find('.');
+void Parser::AddMember(SectionBuilder& section, const Node& node) {
+    section.members.push_back(node);
+    section.index.Add(node.Key(0), arena_, [&section](size_t i) { return section.members[i].Key(0); });
+}
 
-    if (dot == std::string_view::npos) {
-        return Find(path);
-    } else {
-        std::string_view current = path.substr(0, dot);
-        return Find(current).Get(path.substr(current.size() + 1, path.size()));
+Parser::SectionBuilder* Parser::OpenSection(SectionBuilder& parent, std::string_view name) {
+    uint32_t position = FindMember(parent, name);
+    if (position != KeyIndex::kNotFound) {
+        const Node& existing = parent.members[position];
+        return existing.type == NodeType::kSection ? &sections_[existing.size] : nullptr;
+    }
+    if (name.empty()) {
+        return nullptr;
     }
+
+    Node node;
+    node.type = NodeType::kSection;
+    node.size = static_cast<uint32_t>(sections_.size());
+    node.SetKey(arena_.Retain(name));
+    sections_.emplace_back();
+    AddMember(parent, node);
+    return &sections_.back();
 }
 
-void DeleteSpaces(std::string_view& line) {
-    int i;
-    for (i = 0; i < line.size(); i++) {
-        if (line[i] != ' ') {
-            break;
-        }
-    }
-    line.remove_prefix(i);
+void Parser::Error(ErrorKind kind, std::string_view span) {
+    root_.valid_ = false;
+    root_.errors_.push_back(lines_.Locate(kind, span));
+}
 
-    for (i = line.size() - 1; i >= 0; i--) {
-        if (line[i] != ' ') {
-            break;
-        }
+void Parser::UnplacedError(ErrorKind kind, std::string_view key) {
+    root_.valid_ = false;
+    ParseError error;
+    error.kind = kind;
+    error.text = key;
+    root_.errors_.push_back(std::move(error));
+}
+
+void Parser::Emit(Node node) {
+    if (depth_ != 0) {
+        arrays_[depth_ - 1].push_back(node);
+        return;
     }
-    line.remove_suffix(line.size() - i - 1);
+    node.SetKey(arena_.Retain(pending_key_));
+    AddMember(*current_section_, node);
 }
 
-void DeleteComment(std::string_view& line) {
-    bool in_string = false;
-    for (size_t i = 0; i < line.size(); i++) {
-        if (line[i] == '#' && !in_string) {
-            line.remove_suffix(line.size() - i);
+void Parser::OnSection(std::string_view path) {
+    SectionBuilder* section = &sections_.front();
+    std::string_view rest = path;
+    while (true) {
+        size_t dot = rest.find('.');
+        section = OpenSection(*section, rest.substr(0, dot));
+        if (section == nullptr) {
+            // The span is the path up to the component that clashes.
+            size_t end = rest.data() - path.data() + std::min(dot, rest.size());
+            Error(ErrorKind::kSectionConflict, path.substr(0, end));
             return;
-        } else if (line[i] == '\"') {
-            in_string = !in_string;
         }
+        if (dot == std::string_view::npos) {
+            break;
+        }
+        rest.remove_prefix(dot + 1);
     }
+    current_section_ = section;
 }
 
-std::string_view DeleteNeedless(std::string_view line) {
-    if (line.empty()) {
-        return line;
+bool Parser::OnKey(std::string_view key) {
+    uint32_t position = FindMember(*current_section_, key);
+    if (position != KeyIndex::kNotFound) {
+        bool section = current_section_->members[position].type == NodeType::kSection;
+        Error(section ? ErrorKind::kSectionConflict : ErrorKind::kDuplicateKey, key);
+        return false;
     }
-    std::string_view new_line = line;
-    DeleteComment(new_line);
-    DeleteSpaces(new_line);
-    return new_line;
+    pending_key_ = key;
+    depth_ = 0;
+    return true;
 }
 
-void Section::ParseLine(std::string_view line) {
-    std::string_view new_line = DeleteNeedless(line);
-    if (new_line.empty()) {
-        return;
+void Parser::OnInt(int64_t value) {
+    Node node;
+    node.type = NodeType::kInt;
+    node.int_value = value;
+    Emit(node);
+}
+
+void Parser::OnFloat(double value) {
+    Node node;
+    node.type = NodeType::kFloat;
+    node.float_value = value;
+    Emit(node);
+}
+
+void Parser::OnBool(bool value) {
+    Node node;
+    node.type = NodeType::kBool;
+    node.bool_value = value;
+    Emit(node);
+}
+
+void Parser::OnString(std::string_view value) {
+    std::string_view string = arena_.Retain(value);
+    Node node;
+    node.type = NodeType::kString;
+    node.size = static_cast<uint32_t>(string.size());
+    node.SetPayload(string.data());
+    Emit(node);
+}
+
+void Parser::OnArrayBegin() {
+    if (depth_ == arrays_.size()) {
+        arrays_.emplace_back();
     }
-    if (new_line.front() == '[' && new_line.back() == ']') {
-        AddSection(new_line);
-    } else {
-        AddVariable(new_line);
+    arrays_[depth_++].clear();
+}
+
+void Parser::OnArrayEnd() {
+    const std::vector<Node>& elements = arrays_[--depth_];
+    Node node;
+    SetArray(node, elements.data(), elements.size(), arena_);
+    Emit(node);
+}
+
+void Parser::OnError(ErrorKind kind, std::string_view span) {
+    Error(kind, span);
+}
+
+const SectionBody* Parser::Freeze(SectionBuilder& section) {
+    Node* members = arena_.AllocateArray<Node>(section.members.size());
+    for (size_t i = 0; i < section.members.size(); i++) {
+        members[i] = section.members[i];
+        if (members[i].type == NodeType::kSection) {
+            SectionBuilder& child = sections_[members[i].size];
+            members[i].size = static_cast<uint32_t>(child.members.size());
+            members[i].SetPayload(Freeze(child));
+        }
     }
+
+    auto* body = arena_.Create<SectionBody>();
+    body->members = reinterpret_cast<uintptr_t>(members);
+    body->index = section.index;
+    std::vector<Node>().swap(section.members);
+    return body;
 }
 
-void Section::AddSection(std::string_view line) {
-    if (line.size() == 2 || line[line.size() - 2] == '.' || line[1] == '.') {
-        valid_ = false;
-        return;
+Node Parser::Rebase(const Node& node, uintptr_t base) {
+    if (base == 0) {
+        return node;
     }
+    Node result = node;
+    result.SetKey(node.Key(base));
+    if (node.type == NodeType::kString) {
+        result.SetPayload(node.String(base).data());
+    } else if (node.packed != NodeType::kNone) {
+        result.SetPayload(node.Ints(base));
+    } else if (node.type == NodeType::kArray) {
+        Node* elements = arena_.AllocateArray<Node>(node.size);
+        for (size_t i = 0; i < node.size; i++) {
+            elements[i] = Rebase(node.Elements(base)[i], base);
+        }
+        result.SetPayload(elements);
+    }
+    return result;
+}
 
-    size_t start = 1;
-    Section* section = this;
-    for (size_t i = 1; i < line.size() - 1; i++) {
-        if (line[i] == '.') {
-            std::string_view section_name = line.substr(start, i - start);
-            if (section->Find(section_name).IsSection()) {
-                section = dynamic_cast<Section*>(&section->Get(section_name));
-            } else {
-                auto* new_section = new Section(section_name);
-                section->values_.push_back(new_section);
-                section = new_section;
-            }
-            start = i + 1;
-        } else if (!(isdigit(line[i]) || isalpha(line[i]) || line[i] == '-' || line[i] == '_')) {
-            valid_ = false;
-            return;
-        } else if (i == line.size() - 2) {
-            std::string_view section_name = line.substr(start, i - start + 1);
-            if (section->Find(section_name).IsSection()) {
-                section = dynamic_cast<Section*>(&section->Get(section_name));
-            } else {
-                auto* new_section = new Section(section_name);
-                section->values_.push_back(new_section);
-                section = new_section;
+void Parser::MergeSection(SectionBuilder& target, const Node& section, uintptr_t base) {
+    const SectionBody* body = section.Body(base);
+    const Node* members = body->Members(base);
+    if (target.members.empty()) {
+        // Nothing can clash with the members of a section seen for the first time, so
+        // they are taken over in one go together with their index.
+        target.members.reserve(section.size);
+        for (size_t i = 0; i < section.size; i++) {
+            const Node& member = members[i];
+            if (member.type != NodeType::kSection) {
+                target.members.push_back(Rebase(member, base));
+                continue;
             }
-            start = i + 1;
+            Node node;
+            node.type = NodeType::kSection;
+            node.size = static_cast<uint32_t>(sections_.size());
+            node.SetKey(member.Key(base));
+            target.members.push_back(node);
+            sections_.emplace_back();
+            MergeSection(sections_.back(), member, base);
         }
+        target.index = body->index.CopyTo(arena_, base);
+        return;
     }
 
-    current_section = section;
-}
-
-void Section::AddVariable(std::string_view line) {
-    std::string_view key;
-    std::string_view value;
-    bool key_end = false;
-    bool equal = false;
-    for (size_t i = 0; i < line.size(); i++) {
-        if ((equal) && (line[i] != ' ')) {
-            value = line.substr(i, line.size() - i);
-            break;
-        } else if (key_end) {
-            if (line[i] == '=') {
-                equal = true;
-            } else if (line[i] != ' ') {
-                valid_ = false;
+    for (size_t i = 0; i < section.size && root_.valid_; i++) {
+        const Node& member = members[i];
+        if (member.type == NodeType::kSection) {
+            SectionBuilder* child = OpenSection(target, member.Key(base));
+            if (child == nullptr) {
+                UnplacedError(ErrorKind::kSectionConflict, member.Key(base));
                 return;
             }
+            MergeSection(*child, member, base);
+        } else if (uint32_t position = FindMember(target, member.Key(base)); position != KeyIndex::kNotFound) {
+            bool clash = target.members[position].type == NodeType::kSection;
+            UnplacedError(clash ? ErrorKind::kSectionConflict : ErrorKind::kDuplicateKey, member.Key(base));
         } else {
-            if (line[i] == ' ') {
-                key_end = true;
-                key = line.substr(0, i);
-            } else if (line[i] == '=') {
-                key_end = true;
-                equal = true;
-                key = line.substr(0, i);
-            } else if (!(isdigit(line[i]) || isalpha(line[i]) || line[i] == '-' || line[i] == '_')) {
-                valid_ = false;
-                return;
-            }
+            AddMember(target, Rebase(member, base));
         }
     }
+}
 
-    if (current_section->Exists(key) || value.empty() || key.empty()) {
-        valid_ = false;
-    } else {
-        current_section->ParseValue(key, value);
-        if (!current_section->valid_) {
-            valid_ = false;
-        }
+void Parser::Merge(const Section& piece) {
+    if (!piece.valid_) {
+        root_.valid_ = false;
+        root_.errors_.insert(root_.errors_.end(), piece.errors_.begin(), piece.errors_.end());
+        return;
     }
+    arena_.Hold(piece.arena_owner_);
+    OMFL_STATS(
+        root_.stats_ += piece.stats_;
+        PhaseClock clock;
+        clock.Attach(root_.stats_);
+        clock.Switch(&ParseStats::build_ns);
+    )
+    MergeSection(sections_.front(), *piece.node_, piece.base_);
+    OMFL_STATS(clock.Switch(nullptr);)
 }
 
-
-bool IsValueFloat(const std::string_view& value) {
-    size_t dots_count = 0;
-    bool digits = false;
-    for (size_t i = 0; i < value.size(); i++) {
-        if (value[i] == '.') {
-            dots_count++;
-            if (dots_count > 1 || i == 0 || i == value.size() - 1 || (i == 1 && (value[0] == '-' || value[0] == '+'))) {
-                return false;
-            }
-        } else if ((value[i] == '-' || value[i] == '+') && i == 0) {
-            continue;
-        } else if (!isdigit(value[i])) {
-            return false;
-        } else if (!digits && isdigit(value[i])) {
-            digits = true;
+void Parser::Finish() {
+    OMFL_STATS(
+        uint64_t builder_bytes = 0;
+        for (const SectionBuilder& section : sections_) {
+            builder_bytes += section.members.capacity() * sizeof(Node);
         }
-    }
-    if (dots_count == 0 || !digits) {
-        return false;
-    }
-    return true;
+        for (const std::vector<Node>& elements : arrays_) {
+            builder_bytes += elements.capacity() * sizeof(Node);
+        }
+        PhaseClock clock;
+        clock.Attach(root_.stats_);
+        clock.Switch(&ParseStats::build_ns);
+    )
+    auto* root = arena_.Create<Node>();
+    root->type = NodeType::kSection;
+    root->size = static_cast<uint32_t>(sections_.front().members.size());
+    root->SetPayload(Freeze(sections_.front()));
+    root_.node_ = root;
+    OMFL_STATS(
+        clock.Switch(nullptr);
+        root_.stats_.peak_node_bytes += arena_.BytesReserved() + builder_bytes;
+    )
 }
 
-bool IsValueInt(const std::string_view& value) {
-    bool digits = false;
-    for (size_t i = 0; i < value.size(); i++) {
-        if ((value[i] == '-' || value[i] == '+') && i == 0) {
-            continue;
-        } else if (!isdigit(value[i])) {
-            return false;
-        } else if (!digits && isdigit(value[i])) {
-            digits = true;
+void Parser::ParseText(std::string_view text) {
+    lines_ = LineCounter(text);
+    Tokenizer<Parser> tokenizer(*this);
+    OMFL_STATS(tokenizer.Observe(root_.stats_);)
+    tokenizer.ParseText(text);
+}
+
+void Parser::ParseRuns(std::string_view text, const std::vector<std::string_view>& runs,
+                       std::shared_ptr<const void> owner) {
+    arena_.AttachSource(std::move(owner), text);
+    lines_ = LineCounter(text);
+    Tokenizer<Parser> tokenizer(*this);
+    OMFL_STATS(tokenizer.Observe(root_.stats_);)
+    for (std::string_view run : runs) {
+        tokenizer.ParseText(run);
+        if (Stopped()) {
+            break;
         }
     }
-    if (!digits) {
-        return false;
-    }
-    return true;
 }
 
-bool IsValueString(const std::string_view& value) {
-    for (size_t i = 1; i < value.size() - 1; i++) {
-        if (value[i] == '\"') {
-            return false;
+void Parser::ParseChunks(std::string_view text, size_t chunks, size_t threads) {
+    std::vector<std::string_view> pieces;
+    size_t begin = 0;
+    for (size_t i = 1; i < chunks && begin < text.size(); i++) {
+        // Every chunk but the first starts at the first header line after its share of the text.
+        size_t newline = text.find('\n', std::max(begin, text.size() / chunks * i));
+        size_t cut = std::string_view::npos;
+        if (newline != std::string_view::npos) {
+            ForEachHeaderLine(text, newline + 1, [&cut](size_t line_begin, size_t) {
+                cut = line_begin;
+                return false;
+            });
+        }
+        if (cut == std::string_view::npos) {
+            break;
         }
+        pieces.push_back(text.substr(begin, cut - begin));
+        begin = cut;
+    }
+    pieces.push_back(text.substr(begin));
+
+    std::vector<std::shared_ptr<const Section>> documents(pieces.size());
+    ThreadPool pool(std::min(threads, pieces.size()));
+    pool.ParallelFor(pieces.size(), [&](size_t i) {
+        auto document = std::make_shared<Section>();
+        document->arena_owner_->ShareSource(arena_);
+        Parser parser(*document);
+        // A piece only has to tell whether it is valid.
+        parser.stop_at_first_error_ = true;
+        parser.ParseText(pieces[i]);
+        parser.Finish();
+        documents[i] = std::move(document);
+    });
+    for (const auto& document : documents) {
+        Merge(*document);
     }
-    return true;
 }
 
-void Section::ParseValue(std::string_view key, std::string_view value) {
-    if (value.empty()) {
+void Parser::Parse(std::string_view text, const ParseOptions& options) {
+    stop_at_first_error_ = options.stop_at_first_error;
+    size_t threads = options.threads == 0 ? ThreadPool::DefaultSize() : options.threads;
+    size_t chunks = std::min(threads * 4, text.size() / kMinChunkSize);
+    if (threads < 2 || chunks < 2) {
+        ParseText(text);
         return;
     }
-    if (value == "true") {
-        auto* var = new BoolVar(key, true);
-        values_.push_back(var);
-    } else if (value == "false") {
-        auto* var = new BoolVar(key, false);
-        values_.push_back(var);
-    } else if (value.front() == '[' && value.back() == ']') {
-        auto* var = new Array(key);
-        values_.push_back(var);
-
-        int32_t qoute = 0;
-        int32_t bracket = 0;
-        int32_t var_start = 1;
-
-        for (size_t i = 1; i < value.size() - 1; i++) {
-            if (value[i] == '[' && qoute % 2 == 0) {
-                bracket++;
-            } else if (value[i] == '\"' && bracket == 0) {
-                qoute++;
-            } else if (value[i] == ']' && qoute % 2 == 0) {
-                bracket--;
-            } else if (value[i] == ',' && qoute % 2 == 0) {
-                if (bracket == 0) {
-                    var->ParseValue("", DeleteNeedless(value.substr(var_start, i - var_start)));
-                    var_start = i + 1;
-                }
-            }
-        }
-        var->ParseValue("", DeleteNeedless(value.substr(var_start, value.size() - 1 - var_start)));
-        if (!var->valid_) {
-            valid_ = false;
+    ParseChunks(text, chunks, threads);
+    if (!root_.valid_) {
+        sections_.clear();
+        sections_.emplace_back();
+        current_section_ = &sections_.front();
+        root_.valid_ = true;
+        root_.errors_.clear();
+        OMFL_STATS(root_.stats_ = {};)
+        ParseText(text);
+    }
+}
+
+void Parser::ParseFile(const std::filesystem::path& path, const ParseOptions& options) {
+    if (options.map_file) {
+        auto file = std::make_shared<MappedFile>(path);
+        if (!file->valid()) {
+            UnplacedError(ErrorKind::kUnreadableFile, {});
             return;
         }
-
-    } else if (value.front() == '\"' && value.back() == '\"' && IsValueString(value)) {
-        auto* var = new StringVar(key, value.substr(1, value.size() - 2));
-        values_.push_back(var);
-    } else if (IsValueInt(value)) {
-        std::string str_value{value};
-        int32_t casted = std::stoi(str_value);
-        auto* var = new IntVar(key, casted);
-        values_.push_back(var);
-    } else if (IsValueFloat(value)) {
-        std::string str_value{value};
-        float casted = std::atof(str_value.c_str());
-        auto* var = new FloatVar(key, casted);
-        values_.push_back(var);
-    } else {
-        valid_ = false;
+        arena_.AttachSource(file, file->bytes());
+        Parse(file->bytes(), options);
         return;
     }
-}
 
-void Array::ParseValue(std::string_view key, std::string_view value) {
-    if (value.empty()) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        UnplacedError(ErrorKind::kUnreadableFile, {});
         return;
     }
-    if (value == "true") {
-        auto* var = new BoolVar(key, true);
-        values_.push_back(var);
-    } else if (value == "false") {
-        auto* var = new BoolVar(key, false);
-        values_.push_back(var);
-    } else if (value.front() == '[' && value.back() == ']') {
-        auto* var = new Array(key);
-        values_.push_back(var);
-
-        int32_t qoute = 0;
-        int32_t bracket = 0;
-        int32_t var_start = 1;
-
-        for (size_t i = 1; i < value.size() - 1; i++) {
-            if (value[i] == '[' && qoute % 2 == 0) {
-                bracket++;
-            } else if (value[i] == '\"' && bracket == 0) {
-                qoute++;
-            } else if (value[i] == ']' && qoute % 2 == 0) {
-                bracket--;
-            } else if (value[i] == ',' && qoute % 2 == 0) {
-                if (bracket == 0) {
-                    var->ParseValue("", DeleteNeedless(value.substr(var_start, i - var_start)));
-                    var_start = i + 1;
-                }
-            }
-        }
-        var->ParseValue("", DeleteNeedless(value.substr(var_start, value.size() - 1 - var_start)));
-        if (!var->valid_) {
-            valid_ = false;
-            return;
-        }
-
-    } else if (value.front() == '\"' && value.back() == '\"' && IsValueString(value)) {
-        auto* var = new StringVar(key, value.substr(1, value.size() - 2));
-        values_.push_back(var);
-    } else if (IsValueInt(value)) {
-        std::string str_value{value};
-        int32_t casted = std::stoi(str_value);
-        auto* var = new IntVar(key, casted);
-        values_.push_back(var);
-    } else if (IsValueFloat(value)) {
-        std::string str_value{value};
-        float casted = std::atof(str_value.c_str());
-        auto* var = new FloatVar(key, casted);
-        values_.push_back(var);
+    // Regular files are read in one go. Devices and pipes have no size and are read to
+    // the end; a directory opens fine but has no text at all.
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(path, error);
+    std::string text;
+    if (!error) {
+        text.resize(static_cast<size_t>(size));
+        file.read(text.data(), static_cast<std::streamsize>(text.size()));
+        text.resize(static_cast<size_t>(file.gcount()));
+    } else if (std::filesystem::is_directory(path, error)) {
+        UnplacedError(ErrorKind::kUnreadableFile, {});
+        return;
     } else {
-        valid_ = false;
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    if (file.bad()) {
+        UnplacedError(ErrorKind::kUnreadableFile, {});
         return;
     }
+    Parse(text, options);
 }
 
-bool Section::Exists(std::string_view key) const {
-    for (size_t i = 0; i < values_.size(); i++) {
-        if (values_[i]->key_ == key) {
-            return true;
+namespace {
+
+    // Copies node and everything under it into arena as a tree of base 0.
+    Node CloneNode(const Node& node, uintptr_t base, Arena& arena) {
+        Node copy = node;
+        copy.SetKey(arena.CopyString(node.Key(base)));
+        if (node.type == NodeType::kString) {
+            copy.SetPayload(arena.CopyString(node.String(base)).data());
+        } else if (node.packed != NodeType::kNone) {
+            void* values = arena.Allocate(node.PackedBytes(), alignof(int64_t));
+            std::memcpy(values, node.Ints(base), node.PackedBytes());
+            copy.SetPayload(values);
+        } else if (node.type == NodeType::kArray) {
+            Node* elements = arena.AllocateArray<Node>(node.size);
+            for (size_t i = 0; i < node.size; i++) {
+                elements[i] = CloneNode(node.Elements(base)[i], base, arena);
+            }
+            copy.SetPayload(elements);
+        } else if (node.type == NodeType::kSection) {
+            const SectionBody* body = node.Body(base);
+            Node* members = arena.AllocateArray<Node>(node.size);
+            for (size_t i = 0; i < node.size; i++) {
+                members[i] = CloneNode(body->Members(base)[i], base, arena);
+            }
+            auto* body_copy = arena.Create<SectionBody>();
+            body_copy->members = reinterpret_cast<uintptr_t>(members);
+            body_copy->index = body->index.CopyTo(arena, base);
+            copy.SetPayload(body_copy);
         }
+        return copy;
     }
-    return false;
-}
 
-Variable& Section::Find(std::string_view key) const {
-    for (size_t i = 0; i < values_.size(); i++) {
-        if (values_[i]->key_ == key) {
-            return *values_[i];
+    void ParsePath(Document& document, const std::filesystem::path& path, const ParseOptions& options) {
+        Parser parser(document);
+        parser.ParseFile(path, options);
+        parser.Finish();
+        if (options.index_paths) {
+            document.IndexPaths();
         }
     }
-    return empty_var;
 }
 
-Section& omfl::parse(const std::string& code) {
-    auto* root = new Section;
-    current_section = root;
-    std::stringstream buffer(code);
-    std::string line;
-    while (!buffer.eof()) {
-        getline(buffer, line);
-        root->ParseLine(line);
+Document::Document(Document&& other) noexcept : Section(std::move(other)) {
+    other.node_ = &kEmptyNode;
+    other.base_ = 0;
+    other.valid_ = true;
+    other.errors_.clear();
+    other.path_index_.reset();
+}
+
+Document& Document::operator=(Document&& other) noexcept {
+    if (this != &other) {
+        Section::operator=(std::move(other));
+        other.node_ = &kEmptyNode;
+        other.base_ = 0;
+        other.valid_ = true;
+        other.errors_.clear();
+        other.path_index_.reset();
     }
-    return *root;
+    return *this;
 }
 
-Section& omfl::parse(const std::filesystem::path& path) {
-    auto* root = new Section;
-    if (!std::filesystem::exists(path)) {
-        return *root;
+Document Document::Clone() const {
+    Document copy;
+    Arena& arena = *copy.arena_owner_;
+    copy.node_ = arena.Create<Node>(CloneNode(*node_, base_, arena));
+    copy.valid_ = valid_;
+    copy.errors_ = errors_;
+    OMFL_STATS(copy.stats_ = stats_;)
+    if (path_index_ != nullptr) {
+        copy.IndexPaths();
     }
-    current_section = root;
-    std::ifstream file(path.c_str());
-    std::string line;
-    while (!file.eof()) {
-        getline(file, line);
-        root->ParseLine(line);
+    return copy;
+}
+
+Document omfl::parse(const std::string& code, const ParseOptions& options) {
+    Document document;
+    Parser parser(document);
+    parser.Parse(code, options);
+    parser.Finish();
+    if (options.index_paths) {
+        document.IndexPaths();
     }
-    return *root;
+    return document;
 }
 
-void Section::CreateXML(const std::filesystem::path& path) const {
-    std::ofstream file(path.c_str());
-    file << '<' << "root" << '>' << '\n';
-    for (size_t i = 0; i < values_.size(); i++) {
-        values_[i]->WriteXML(file);
+Document omfl::parse(const std::filesystem::path& path, const ParseOptions& options) {
+    Document document;
+    ParsePath(document, path, options);
+    return document;
+}
+
+Document omfl::merge(const std::vector<std::shared_ptr<const Section>>& pieces) {
+    Document document;
+    Parser parser(document);
+    for (const auto& piece : pieces) {
+        parser.Merge(*piece);
     }
-    file << "</" << "root" << '>' << '\n';
+    parser.Finish();
+    return document;
+}
+
+Document omfl::parse_runs(std::string_view text, const std::vector<std::string_view>& runs,
+                          std::shared_ptr<const void> owner) {
+    Document document;
+    Parser parser(document);
+    parser.ParseRuns(text, runs, std::move(owner));
+    parser.Finish();
+    return document;
+}
+
+std::vector<Document> omfl::parse_many(const std::vector<std::filesystem::path>& paths, size_t threads,
+                                       const ParseOptions& options) {
+    std::vector<Document> result(paths.size());
+    ThreadPool pool(std::min(threads == 0 ? ThreadPool::DefaultSize() : threads, paths.size()));
+    pool.ParallelFor(paths.size(), [&](size_t i) {
+        ParsePath(result[i], paths[i], options);
+    });
+    return result;
+}
+
+std::vector<QueryMatch> Section::Query(std::string_view pattern) const {
+    return RunQuery(*node_, base_, path_index_.get(), pattern);
+}
+
+void Section::IndexPaths() {
+    path_index_ = std::make_shared<const PathIndex>(*node_, base_);
+}
+
+void Section::WriteXML(OutputSink& sink) const {
+    XmlWriter writer(sink);
+    WriteDocument(*node_, base_, writer);
+}
+
+void Section::WriteYAML(OutputSink& sink) const {
+    YamlWriter writer(sink);
+    WriteDocument(*node_, base_, writer);
+}
+
+void Section::WriteJSON(OutputSink& sink) const {
+    JsonWriter writer(sink);
+    WriteDocument(*node_, base_, writer);
+}
+
+void Section::WriteMsgPack(OutputSink& sink) const {
+    MsgPackWriter writer(sink);
+    WriteDocument(*node_, base_, writer);
+}
+
+void Section::CreateXML(const std::filesystem::path& path) const {
+    FileSink sink(path);
+    WriteXML(sink);
 }
 
 void Section::CreateYAML(const std::filesystem::path& path) const {
-    std::ofstream file(path.c_str());
-    file << "---" << '\n';
-    for (size_t i = 0; i < values_.size(); i++) {
-        values_[i]->WriteYAML(file, 0);
-    }
-    file << "...";
+    FileSink sink(path);
+    WriteYAML(sink);
 }
 
 void Section::CreateJSON(const std::filesystem::path& path) const {
-    std::ofstream file(path.c_str());
-    file << '{' << '\n';
-    for (size_t i = 0; i < values_.size(); i++) {
-        values_[i]->WriteJSON(file, 1);
-        if (i != values_.size() - 1) {
-            file << ',';
+    FileSink sink(path);
+    WriteJSON(sink);
+}
+
+void Section::CreateMsgPack(const std::filesystem::path& path) const {
+    FileSink sink(path);
+    WriteMsgPack(sink);
+}
+
+bool Section::Export(const std::vector<ExportTarget>& targets, size_t threads) const {
+    size_t groups = std::min(threads == 0 ? ThreadPool::DefaultSize() : threads, targets.size());
+    std::vector<char> written(targets.size());
+    auto export_group = [&](size_t group) {
+        std::vector<std::unique_ptr<FileSink>> sinks;
+        std::vector<std::unique_ptr<Writer>> writers;
+        std::vector<Writer*> outputs;
+        for (size_t i = group; i < targets.size(); i += groups) {
+            sinks.push_back(std::make_unique<FileSink>(targets[i].path));
+            writers.push_back(MakeWriter(targets[i].format, *sinks.back()));
+            outputs.push_back(writers.back().get());
+        }
+        FanOutWriter writer(std::move(outputs));
+        WriteDocument(*node_, base_, writer);
+        for (size_t i = group, k = 0; i < targets.size(); i += groups, k++) {
+            written[i] = sinks[k]->Close();
         }
-        file << '\n';
+    };
+    if (groups < 2) {
+        for (size_t group = 0; group < groups; group++) {
+            export_group(group);
+        }
+    } else {
+        ThreadPool(groups).ParallelFor(groups, export_group);
     }
-    file << '}';
+    return std::all_of(written.begin(), written.end(), [](char ok) { return ok != 0; });
 }
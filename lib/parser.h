@@ -7,413 +7,365 @@
 #include <string_view>
 #include <sstream>
 #include <vector>
+#include <cstdint>
 #include <exception>
+#include <stdexcept>
+#include <memory>
+#include <optional>
 
+#include "arena.h"
+#include "compiled_path.h"
+#include "errors.h"
+#include "node.h"
+#include "output.h"
+#include "stats.h"
+#include "writer.h"
 
-namespace omfl {
-
-    class Variable {
-
-    public:
-
-        bool valid_ = true;
-        std::string key_;
 
-        Variable() = default;
+namespace omfl {
 
-        Variable(std::string_view key) {
-            key_ = key;
-        }
+    class Document;
 
-        virtual bool IsInt() const {
-            return false;
-        }
+    class MsgPackReader;
 
-        virtual int32_t AsInt() const {
-            throw std::invalid_argument("Invalid type of Variable");
-        }
+    class Parser;
 
-        virtual int32_t AsIntOrDefault(int32_t value) const {
-            return value;
-        }
+    class PathIndex;
 
-        virtual bool IsFloat() const {
-            return false;
-        }
+    struct ParseOptions {
+        // Parse the file through a read-only memory mapping. Keys and strings of the document
+        // then point straight into the mapping, which lives as long as the document does,
+        // so the file must not be modified in the meantime.
+        bool map_file = false;
+        // Threads one document is parsed with, 0 for one per hardware thread. Big documents
+        // are then cut at section headers into chunks parsed side by side and merged in
+        // order, with the same result as a parse on one thread.
+        size_t threads = 1;
+        // End the parse at the first error instead of reporting every error of the text.
+        bool stop_at_first_error = false;
+        // Build the index Section::Query uses for patterns with `**`, see IndexPaths.
+        bool index_paths = false;
+    };
 
-        virtual float AsFloat() const {
-            throw std::invalid_argument("Invalid type of Variable");
-        }
+    // One output of Section::Export.
+    struct ExportTarget {
+        Format format = Format::kJson;
+        std::filesystem::path path;
+    };
 
-        virtual float AsFloatOrDefault(float value) const {
-            return value;
-        }
+    inline const Node kEmptyNode{};
 
-        virtual bool IsString() const {
-            return false;
-        }
+    // Read-only view of a run of values inside a document, valid as long as the document is.
+    template<typename T>
+    class Span {
+    private:
 
-        virtual std::string AsString() const {
-            throw std::invalid_argument("Invalid type of Variable");
-        }
+        const T* data_ = nullptr;
+        size_t size_ = 0;
 
-        virtual std::string AsStringOrDefault(const std::string& value) const {
-            return value;
-        }
+    public:
 
-        virtual bool IsBool() const {
-            return false;
-        }
+        Span() = default;
 
-        virtual bool AsBool() const {
-            throw std::invalid_argument("Invalid type of Variable");
+        Span(const T* data, size_t size) : data_(data), size_(size) {
         }
 
-        virtual bool AsBoolOrDefault(bool value) const {
-            return value;
+        const T* data() const {
+            return data_;
         }
 
-        virtual bool IsArray() const {
-            return false;
+        size_t size() const {
+            return size_;
         }
 
-        virtual bool IsSection() const {
-            return false;
+        bool empty() const {
+            return size_ == 0;
         }
 
-        virtual Variable& operator[](size_t index) const;
-
-        virtual Variable& Get(std::string_view path) const;
-
-        virtual void WriteXML(std::ofstream& file) const {
-            return;
+        const T* begin() const {
+            return data_;
         }
 
-        virtual void WriteYAML(std::ofstream& file, size_t margins) const {
-            return;
+        const T* end() const {
+            return data_ + size_;
         }
 
-        virtual void WriteJSON(std::ofstream& file, size_t tabs) const {
-            return;
+        const T& operator[](size_t index) const {
+            return data_[index];
         }
 
     };
 
-    class IntVar : public Variable {
-    private:
+    // Read-only view of one Node and the base of its tree. Copying it is as cheap as
+    // copying two pointers and an index, and a default-constructed or not found Variable
+    // answers false to every Is* question.
+    class Variable {
+    protected:
 
-        int32_t value_;
+        static constexpr uint32_t kWhole = UINT32_MAX;
 
-    public:
+        const Node* node_ = &kEmptyNode;
+        uintptr_t base_ = 0;
+        // Elements of packed arrays have no node of their own: for one of them node_ is
+        // the array and this is the position of the element in it.
+        uint32_t element_ = kWhole;
 
-        IntVar(std::string_view key, int32_t value) : Variable(key), value_(value) {
+        Variable(const Node* array, uintptr_t base, uint32_t element) : node_(array), base_(base), element_(element) {
         }
 
-        bool IsInt() const override {
-            return true;
+        NodeType Type() const {
+            return element_ == kWhole ? node_->type : node_->packed;
         }
 
-        int32_t AsInt() const override {
-            return value_;
+        int64_t IntValue() const {
+            return element_ == kWhole ? node_->int_value : node_->Ints(base_)[element_];
         }
 
-        int32_t AsIntOrDefault(int32_t value) const override {
-            return value_;
+        double FloatValue() const {
+            return element_ == kWhole ? node_->float_value : node_->Floats(base_)[element_];
         }
 
-    private:
-
-        void WriteXML(std::ofstream& file) const override {
-            file << '<' << key_ << '>' << value_ << "</" << key_ << '>' << '\n';
+        bool BoolValue() const {
+            return element_ == kWhole ? node_->bool_value : node_->Bools(base_)[element_];
         }
 
-        void WriteYAML(std::ofstream& file, size_t margins) const override {
-            for (size_t j = 0; j < margins; j++) {
-                file << ' ';
-            }
-            if (key_.empty()) {
-                file << "- " << value_ << '\n';
-            } else {
-                file << key_ << ": " << value_ << '\n';
+        void Expect(NodeType type) const {
+            if (Type() != type) {
+                throw std::invalid_argument("Invalid type of Variable");
             }
         }
 
-        void WriteJSON(std::ofstream& file, size_t tabs) const override {
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            if (key_.empty()) {
-                file << value_;
-            } else {
-                file << '\"' << key_ << "\": " << value_;
+        // Expects a packed array of type, or an empty array.
+        void ExpectPacked(NodeType type) const {
+            if (Type() != NodeType::kArray || (node_->packed != type && node_->size != 0)) {
+                throw std::invalid_argument("Invalid type of Variable");
             }
         }
 
-    };
-
-    class FloatVar : public Variable {
-    private:
-
-        float value_;
-
     public:
 
-        FloatVar(std::string_view key, float value) : Variable(key), value_(value) {
-        }
+        Variable() = default;
 
-        bool IsFloat() const override {
-            return true;
+        explicit Variable(const Node* node, uintptr_t base = 0) : node_(node == nullptr ? &kEmptyNode : node), base_(base) {
         }
 
-        float AsFloat() const override {
-            return value_;
+        // The array itself for an element of a packed array.
+        const Node& node() const {
+            return *node_;
         }
 
-        float AsFloatOrDefault(float value) const override {
-            return value_;
+        uintptr_t base() const {
+            return base_;
         }
 
-    private:
-
-        void WriteXML(std::ofstream& file) const override {
-            file << '<' << key_ << '>' << value_ << "</" << key_ << '>' << '\n';
+        std::string_view key() const {
+            return element_ == kWhole ? node_->Key(base_) : std::string_view();
         }
 
-        void WriteYAML(std::ofstream& file, size_t margins) const override {
-            for (size_t j = 0; j < margins; j++) {
-                file << ' ';
-            }
-            if (key_.empty()) {
-                file << "- " << value_ << '\n';
-            } else {
-                file << key_ << ": " << value_ << '\n';
-            }
+        bool IsInt() const {
+            return Type() == NodeType::kInt && IntValue() >= INT32_MIN && IntValue() <= INT32_MAX;
         }
 
-        void WriteJSON(std::ofstream& file, size_t tabs) const override {
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            if (key_.empty()) {
-                file << value_;
-            } else {
-                file << '\"' << key_ << "\": " << value_;
+        int32_t AsInt() const {
+            Expect(NodeType::kInt);
+            if (!IsInt()) {
+                throw std::out_of_range("Variable does not fit in int32_t");
             }
+            return static_cast<int32_t>(IntValue());
         }
 
-    };
-
-    class StringVar : public Variable {
-    private:
-
-        std::string value_;
-
-    public:
-
-        StringVar(std::string_view key, std::string_view value) : Variable(key), value_(value) {
+        int32_t AsIntOrDefault(int32_t value) const {
+            return IsInt() ? static_cast<int32_t>(IntValue()) : value;
         }
 
-        bool IsString() const override {
-            return true;
+        bool IsInt64() const {
+            return Type() == NodeType::kInt;
         }
 
-        std::string AsString() const override {
-            return value_;
+        int64_t AsInt64() const {
+            Expect(NodeType::kInt);
+            return IntValue();
         }
 
-        std::string AsStringOrDefault(const std::string& value) const override {
-            return value_;
+        int64_t AsInt64OrDefault(int64_t value) const {
+            return IsInt64() ? IntValue() : value;
         }
 
-    private:
-
-        void WriteXML(std::ofstream& file) const override {
-            file << '<' << key_ << '>' << value_ << "</" << key_ << '>' << '\n';
+        bool IsFloat() const {
+            return Type() == NodeType::kFloat;
         }
 
-        void WriteYAML(std::ofstream& file, size_t margins) const override {
-            for (size_t j = 0; j < margins; j++) {
-                file << ' ';
-            }
-            if (key_.empty()) {
-                file << "- " << value_ << '\n';
-            } else {
-                file << key_ << ": " << value_ << '\n';
-            }
+        float AsFloat() const {
+            Expect(NodeType::kFloat);
+            return static_cast<float>(FloatValue());
         }
 
-        void WriteJSON(std::ofstream& file, size_t tabs) const override {
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            if (key_.empty()) {
-                file << value_;
-            } else {
-                file << '\"' << key_ << "\": \"" << value_ << '\"';
-            }
-
+        float AsFloatOrDefault(float value) const {
+            return IsFloat() ? static_cast<float>(FloatValue()) : value;
         }
 
-    };
-
-
-    class BoolVar : public Variable {
-    private:
-
-        bool value_;
-
-    public:
-
-        BoolVar(std::string_view key, bool value) : Variable(key), value_(value) {
+        double AsDouble() const {
+            Expect(NodeType::kFloat);
+            return FloatValue();
         }
 
-        bool IsBool() const override {
-            return true;
+        double AsDoubleOrDefault(double value) const {
+            return IsFloat() ? FloatValue() : value;
         }
 
-        bool AsBool() const override {
-            return value_;
+        bool IsString() const {
+            return Type() == NodeType::kString;
         }
 
-        bool AsBoolOrDefault(bool value) const override {
-            return value_;
+        std::string AsString() const {
+            return std::string(AsStringView());
         }
 
-    private:
-
-        void WriteXML(std::ofstream& file) const override {
-            file << '<' << key_ << '>' << (value_ ? "true" : "false") << "</" << key_ << '>' << '\n';
+        std::string AsStringOrDefault(const std::string& value) const {
+            return IsString() ? AsString() : value;
         }
 
-        void WriteYAML(std::ofstream& file, size_t margins) const override {
-            for (size_t j = 0; j < margins; j++) {
-                file << ' ';
-            }
-            if (key_.empty()) {
-                file << "- " << (value_ ? "true" : "false") << '\n';
-            } else {
-                file << key_ << ": " << (value_ ? "true" : "false") << '\n';
-            }
+        // Points into the document, so it is valid as long as the document is.
+        std::string_view AsStringView() const {
+            Expect(NodeType::kString);
+            return node_->String(base_);
         }
 
-        void WriteJSON(std::ofstream& file, size_t tabs) const override {
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            if (key_.empty()) {
-                file << value_;
-            } else {
-                file << '\"' << key_ << "\": " << (value_ ? "true" : "false");
-            }
+        std::string_view AsStringViewOrDefault(std::string_view value) const {
+            return IsString() ? node_->String(base_) : value;
         }
 
-    };
+        bool IsBool() const {
+            return Type() == NodeType::kBool;
+        }
 
-    class Array : public Variable {
-    private:
+        bool AsBool() const {
+            Expect(NodeType::kBool);
+            return BoolValue();
+        }
 
-        std::vector<Variable*> values_;
+        bool AsBoolOrDefault(bool value) const {
+            return IsBool() ? BoolValue() : value;
+        }
 
-        void PushVar(Variable& var) {
-            values_.push_back(&var);
+        bool IsArray() const {
+            return Type() == NodeType::kArray;
         }
 
-    public:
+        bool IsSection() const {
+            return Type() == NodeType::kSection;
+        }
 
-        Array(std::string_view key) : Variable(key) {
+        // Number of array elements or section members, 0 for anything else.
+        size_t Size() const {
+            return IsArray() || IsSection() ? node_->size : 0;
         }
 
-        ~Array() {
-            for (size_t i = 0; i < values_.size(); i++) {
-                delete values_[i];
+        Variable operator[](size_t index) const {
+            if (!IsArray() || index >= node_->size) {
+                return {};
+            }
+            if (node_->packed != NodeType::kNone) {
+                return Variable(node_, base_, static_cast<uint32_t>(index));
             }
+            return Variable(node_->Elements(base_) + index, base_);
         }
 
-        bool IsArray() const override {
-            return true;
+        // Elements of an array of ints, which is stored as one contiguous run of them.
+        // Throws std::invalid_argument for anything else, an empty array aside.
+        Span<int64_t> AsIntSpan() const {
+            ExpectPacked(NodeType::kInt);
+            return {node_->Ints(base_), node_->size};
         }
 
-        Variable& operator[](size_t index) const override;
-
-        void ParseValue(std::string_view key, std::string_view value);
+        // Elements of an array of floats, like AsIntSpan. An array that mixes ints and
+        // floats is not one.
+        Span<double> AsFloatSpan() const {
+            ExpectPacked(NodeType::kFloat);
+            return {node_->Floats(base_), node_->size};
+        }
 
-    private:
+        Variable Get(std::string_view path) const;
 
-        void WriteYAML(std::ofstream& file, size_t margins) const override {
-            for (size_t j = 0; j < margins; j++) {
-                file << ' ';
-            }
-            if (key_.empty()) {
-                file << "- " << '\n';
-            } else {
-                file << key_ << ": " << '\n';
-            }
-            for (size_t i = 0; i < values_.size(); i++) {
-                values_[i]->WriteYAML(file, margins + 1);
-            }
+        // Resolves a precompiled path: no splitting and no hashing of the segments, and
+        // no search of a section where the key is still at the position the path remembers.
+        Variable Get(const CompiledPath& path) const {
+            return Variable(path.Resolve(*node_, base_), base_);
         }
 
-        void WriteJSON(std::ofstream& file, size_t tabs) const override {
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            if (!key_.empty()) {
-                file << '\"' << key_ << "\": ";
-            }
-            file << '[' << '\n';
-            for (size_t i = 0; i < values_.size(); i++) {
-                values_[i]->WriteJSON(file, tabs + 1);
-                if (i != values_.size() - 1) {
-                    file << ',';
-                }
-                file << '\n';
-            }
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            file << ']';
-        }
     };
 
+    struct QueryMatch {
+        // Dotted path of the node, as Get takes it.
+        std::string path;
+        Variable value;
+    };
+
+    // Root of a parsed document. It shares the arena every node of the document lives in,
+    // so copies of it are cheap views that keep the tree alive.
     class Section : public Variable {
     private:
 
-        std::vector<Variable*> values_;
-
-        void AddSection(std::string_view line);
+        std::shared_ptr<Arena> arena_owner_;
+        bool valid_ = true;
+        std::vector<ParseError> errors_;
+        std::shared_ptr<const PathIndex> path_index_;
+#ifdef OMFL_ENABLE_STATS
+        ParseStats stats_;
+#endif
 
-        void AddVariable(std::string_view line);
+        friend class Document;
 
-        Variable& Find(std::string_view key) const;
+        friend class MsgPackReader;
 
-        bool Exists(std::string_view key) const;
+        friend class Parser;
 
-        void ParseValue(std::string_view key, std::string_view value);
+        friend std::optional<Document> load_snapshot(const std::filesystem::path& snapshot, uint64_t source_hash);
 
     public:
 
-        Section() = default;
+        Section();
 
-        Section(std::string_view key) : Variable(key) {
+        bool valid() const {
+            return valid_;
         }
 
-        ~Section() {
-            for (size_t i = 0; i < values_.size(); i++) {
-                delete values_[i];
-            }
+        // Errors in text order, empty for a valid document. The tree of an invalid
+        // document is incomplete.
+        const std::vector<ParseError>& errors() const {
+            return errors_;
         }
 
-        bool IsSection() const override {
-            return true;
+#ifdef OMFL_ENABLE_STATS
+        // What parsing this document took. Documents built by merge() add up their pieces.
+        const ParseStats& stats() const {
+            return stats_;
         }
+#endif
 
-        Variable& Get(std::string_view path) const override;
+        // Every node whose dotted path matches pattern, each once. A segment of the pattern
+        // is a name, `*` for any one name, `prefix*` for any name starting with prefix, or
+        // `**` for any number of names, none included: `servers.*.port`, `**.timeout`.
+        // Names are found through the section indexes, so the work follows the members
+        // the wildcards go through rather than the size of the document. A `**` followed by
+        // a name is answered from the path index when the document has one, otherwise by
+        // walking the tree below it. Without `**` the matches come in document order.
+        // Throws std::invalid_argument for an empty segment or a `*` anywhere else in one.
+        std::vector<QueryMatch> Query(std::string_view pattern) const;
 
-        void ParseLine(std::string_view line);
+        // Indexes every member of the tree by key for Query. parse does it when asked to
+        // with ParseOptions::index_paths; other documents can be indexed afterwards.
+        void IndexPaths();
 
-        bool valid() const {
-            return valid_;
-        }
+        // Serializers write through a buffer to any sink; Create* write to a file.
+        void WriteXML(OutputSink& sink) const;
+
+        void WriteYAML(OutputSink& sink) const;
+
+        void WriteJSON(OutputSink& sink) const;
+
+        // Compact binary form that load_msgpack reads back, see MsgPackWriter.
+        void WriteMsgPack(OutputSink& sink) const;
 
         void CreateXML(const std::filesystem::path& path) const;
 
@@ -421,47 +373,55 @@ namespace omfl {
 
         void CreateJSON(const std::filesystem::path& path) const;
 
-    private:
+        void CreateMsgPack(const std::filesystem::path& path) const;
 
-        void WriteXML(std::ofstream& file) const override {
-            file << '<' << key_ << '>' << '\n';
-            for (size_t i = 0; i < values_.size(); i++) {
-                values_[i]->WriteXML(file);
-            }
-            file << "</" << key_ << '>' << '\n';
-        }
+        // Writes every target at once. The targets are shared out among `threads` threads,
+        // one per hardware thread when 0, and each thread walks the tree once for all of
+        // its targets. Returns false if any file could not be written.
+        bool Export(const std::vector<ExportTarget>& targets, size_t threads = 0) const;
 
-        void WriteYAML(std::ofstream& file, size_t margins) const override {
-            for (size_t j = 0; j < margins; j++) {
-                file << ' ';
-            }
-            file << key_ << ": " << '\n';
-            for (size_t i = 0; i < values_.size(); i++) {
-                values_[i]->WriteYAML(file, margins + 1);
-            }
-        }
+    };
 
-        void WriteJSON(std::ofstream& file, size_t tabs) const override {
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            file << '\"' << key_ << "\": {" << '\n';
-            for (size_t i = 0; i < values_.size(); i++) {
-                values_[i]->WriteJSON(file, tabs + 1);
-                if (i != values_.size() - 1) {
-                    file << ',';
-                }
-                file << '\n';
-            }
-            for (size_t j = 0; j < tabs; j++) {
-                file << "  ";
-            }
-            file << '}';
-        }
+    // Owner of a parsed document: its tree, the arena and whatever the arena keeps alive,
+    // such as a mapped file. Moving it moves one pointer and leaves an empty document
+    // behind. Copies have to be asked for with Clone.
+    class Document final : public Section {
+    public:
+
+        Document() = default;
+
+        Document(const Document&) = delete;
+
+        Document& operator=(const Document&) = delete;
+
+        Document(Document&& other) noexcept;
+
+        Document& operator=(Document&& other) noexcept;
+
+        // Deep copy into an arena of its own, sharing nothing with this document: not
+        // even a mapped file or the pieces of a merge.
+        Document Clone() const;
 
     };
 
-    Section& parse(const std::string& code);
+    Document parse(const std::string& code, const ParseOptions& options = {});
+
+    Document parse(const std::filesystem::path& path, const ParseOptions& options = {});
+
+    // Builds the document of a text from documents parsed from consecutive pieces of it,
+    // each but the first starting at a section header. The result is the same as parsing
+    // the whole text, and it keeps the pieces alive. Errors of an invalid piece keep their
+    // positions within that piece; clashes between pieces have no position.
+    Document merge(const std::vector<std::shared_ptr<const Section>>& pieces);
+
+    // Parses runs, pieces of text given in text order, as one document. Keys and strings
+    // are not copied out of text, which owner keeps alive as long as the document lives,
+    // and errors are placed in the whole of text.
+    Document parse_runs(std::string_view text, const std::vector<std::string_view>& runs,
+                        std::shared_ptr<const void> owner);
 
-    Section& parse(const std::filesystem::path& path);
-}
\ No newline at end of file
+    // Parses every file on a pool of `threads` workers (hardware concurrency when 0).
+    // The result is in the same order as `paths`.
+    std::vector<Document> parse_many(const std::vector<std::filesystem::path>& paths, size_t threads = 0,
+                                     const ParseOptions& options = {});
+}
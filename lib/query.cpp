@@ -0,0 +1,251 @@
+#include "query.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace omfl;
+
+namespace {
+
+    struct Segment {
+        enum Kind : uint8_t {
+            kName,
+            kAny,
+            kPrefix,
+            kAnyDepth,
+        };
+
+        Kind kind = kName;
+        // The name, or the prefix without its star.
+        std::string_view text;
+        uint32_t hash = 0;
+
+        bool Matches(std::string_view key) const {
+            switch (kind) {
+                case kName:
+                    return key == text;
+                case kPrefix:
+                    return key.substr(0, text.size()) == text;
+                default:
+                    return true;
+            }
+        }
+    };
+
+    std::vector<Segment> ParsePattern(std::string_view pattern) {
+        std::vector<Segment> segments;
+        while (true) {
+            size_t dot = pattern.find('.');
+            Segment segment;
+            segment.text = pattern.substr(0, dot);
+            size_t star = segment.text.find('*');
+            if (segment.text.empty()) {
+                throw std::invalid_argument("Invalid query pattern");
+            } else if (segment.text == "**") {
+                segment.kind = Segment::kAnyDepth;
+            } else if (segment.text == "*") {
+                segment.kind = Segment::kAny;
+            } else if (star == segment.text.size() - 1) {
+                segment.kind = Segment::kPrefix;
+                segment.text.remove_suffix(1);
+            } else if (star != std::string_view::npos) {
+                throw std::invalid_argument("Invalid query pattern");
+            } else {
+                segment.hash = HashKey(segment.text);
+            }
+            segments.push_back(segment);
+            if (dot == std::string_view::npos) {
+                break;
+            }
+            pattern.remove_prefix(dot + 1);
+        }
+        return segments;
+    }
+
+    // Whether names, a path from the root, match segments [first, last).
+    bool MatchNames(const std::vector<Segment>& segments, size_t first, size_t last,
+                    const std::vector<std::string_view>& names, size_t name) {
+        if (first == last) {
+            return name == names.size();
+        }
+        if (segments[first].kind == Segment::kAnyDepth) {
+            return MatchNames(segments, first + 1, last, names, name) ||
+                   (name < names.size() && MatchNames(segments, first, last, names, name + 1));
+        }
+        return name < names.size() && segments[first].Matches(names[name]) &&
+               MatchNames(segments, first + 1, last, names, name + 1);
+    }
+
+    // Matches the segments from some position on against the tree below a node.
+    class Expander {
+    private:
+
+        const std::vector<Segment>& segments_;
+        uintptr_t base_;
+        std::vector<QueryMatch>& matches_;
+        // Only needed when `**` lets one node be reached in more than one way.
+        std::unordered_set<const Node*> seen_;
+        bool deduplicate_;
+        std::string path_;
+
+        void Match(const Node& node) {
+            if (path_.empty() || (deduplicate_ && !seen_.insert(&node).second)) {
+                return;
+            }
+            matches_.push_back({path_, Variable(&node, base_)});
+        }
+
+        void Descend(const Node& member, size_t segment) {
+            size_t length = path_.size();
+            if (length != 0) {
+                path_ += '.';
+            }
+            path_ += member.Key(base_);
+            Expand(member, segment);
+            path_.resize(length);
+        }
+
+    public:
+
+        Expander(const std::vector<Segment>& segments, uintptr_t base, std::vector<QueryMatch>& matches, bool deduplicate)
+            : segments_(segments), base_(base), matches_(matches), deduplicate_(deduplicate) {
+        }
+
+        void SetPath(std::string_view path) {
+            path_.assign(path);
+        }
+
+        void Expand(const Node& node, size_t segment) {
+            if (segment == segments_.size()) {
+                Match(node);
+                return;
+            }
+            const Segment& current = segments_[segment];
+            if (current.kind == Segment::kAnyDepth) {
+                Expand(node, segment + 1);
+            }
+            if (node.type != NodeType::kSection) {
+                return;
+            }
+            if (current.kind == Segment::kName) {
+                if (const Node* member = FindMember(node, current.text, current.hash, base_)) {
+                    Descend(*member, segment + 1);
+                }
+                return;
+            }
+            const Node* members = node.Body(base_)->Members(base_);
+            for (size_t i = 0; i < node.size; i++) {
+                if (current.kind == Segment::kAnyDepth) {
+                    Descend(members[i], segment);
+                } else if (current.Matches(members[i].Key(base_))) {
+                    Descend(members[i], segment + 1);
+                }
+            }
+        }
+
+    };
+}
+
+PathIndex::PathIndex(const Node& root, uintptr_t base) : base_(base) {
+    std::vector<uint32_t> key_ids;
+    if (root.type == NodeType::kSection) {
+        Add(root, kRoot, key_ids);
+    }
+
+    offsets_.assign(keys_.size() + 1, 0);
+    for (uint32_t key : key_ids) {
+        offsets_[key + 1]++;
+    }
+    for (size_t i = 0; i < keys_.size(); i++) {
+        offsets_[i + 1] += offsets_[i];
+    }
+    postings_.resize(entries_.size());
+    std::vector<uint32_t> next(offsets_.begin(), offsets_.end() - 1);
+    for (uint32_t entry = 0; entry < entries_.size(); entry++) {
+        postings_[next[key_ids[entry]]++] = entry;
+    }
+}
+
+void PathIndex::Add(const Node& section, uint32_t parent, std::vector<uint32_t>& key_ids) {
+    auto key_at = [this](size_t i) { return keys_[i]; };
+    const Node* members = section.Body(base_)->Members(base_);
+    for (size_t i = 0; i < section.size; i++) {
+        auto entry = static_cast<uint32_t>(entries_.size());
+        entries_.push_back({members + i, parent});
+
+        std::string_view key = members[i].Key(base_);
+        uint32_t key_id = keys_index_.Find(key, key_at);
+        if (key_id == KeyIndex::kNotFound) {
+            key_id = static_cast<uint32_t>(keys_.size());
+            keys_.push_back(key);
+            keys_index_.Add(key, arena_, key_at);
+        }
+        key_ids.push_back(key_id);
+
+        if (members[i].type == NodeType::kSection) {
+            Add(members[i], entry, key_ids);
+        }
+    }
+}
+
+std::pair<const uint32_t*, const uint32_t*> PathIndex::Find(std::string_view key) const {
+    uint32_t key_id = keys_index_.Find(key, [this](size_t i) { return keys_[i]; });
+    if (key_id == KeyIndex::kNotFound) {
+        return {nullptr, nullptr};
+    }
+    return {postings_.data() + offsets_[key_id], postings_.data() + offsets_[key_id + 1]};
+}
+
+void PathIndex::AppendAncestors(uint32_t entry, std::vector<std::string_view>& keys) const {
+    size_t first = keys.size();
+    for (uint32_t parent = entries_[entry].parent; parent != kRoot; parent = entries_[parent].parent) {
+        keys.push_back(entries_[parent].node->Key(base_));
+    }
+    std::reverse(keys.begin() + static_cast<std::ptrdiff_t>(first), keys.end());
+}
+
+std::vector<QueryMatch> omfl::RunQuery(const Node& root, uintptr_t base, const PathIndex* index,
+                                       std::string_view pattern) {
+    std::vector<Segment> segments = ParsePattern(pattern);
+    std::vector<QueryMatch> matches;
+
+    size_t last_name = segments.size();
+    bool any_depth = false;
+    bool any_depth_before_name = false;
+    for (size_t i = 0; i < segments.size(); i++) {
+        any_depth = any_depth || segments[i].kind == Segment::kAnyDepth;
+        if (segments[i].kind == Segment::kName) {
+            last_name = i;
+            any_depth_before_name = any_depth;
+        }
+    }
+    Expander expander(segments, base, matches, any_depth);
+
+    if (index == nullptr || !any_depth_before_name) {
+        expander.Expand(root, 0);
+        return matches;
+    }
+
+    // Start from the members named like the last name of the pattern, keep those whose
+    // path up to them fits, and expand the rest of the pattern below them.
+    std::vector<std::string_view> names;
+    std::string path;
+    auto [begin, end] = index->Find(segments[last_name].text);
+    for (const uint32_t* entry = begin; entry != end; entry++) {
+        names.clear();
+        index->AppendAncestors(*entry, names);
+        if (!MatchNames(segments, 0, last_name, names, 0)) {
+            continue;
+        }
+        path.clear();
+        for (std::string_view name : names) {
+            path += name;
+            path += '.';
+        }
+        path += index->NodeAt(*entry).Key(base);
+        expander.SetPath(path);
+        expander.Expand(index->NodeAt(*entry), last_name + 1);
+    }
+    return matches;
+}
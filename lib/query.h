@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "key_index.h"
+#include "node.h"
+#include "parser.h"
+
+
+namespace omfl {
+
+    // Every member of every section of a tree, by key: the nodes a `**.name` query
+    // could end at, without walking the tree to find them.
+    class PathIndex {
+    private:
+
+        static constexpr uint32_t kRoot = UINT32_MAX;
+
+        struct Entry {
+            const Node* node;
+            // Entry of the section the node is a member of, kRoot for the root section.
+            uint32_t parent;
+        };
+
+        uintptr_t base_;
+        // In document order, so the entries of one key are too.
+        std::vector<Entry> entries_;
+
+        // Distinct keys and, for the key at position i, its entries in
+        // postings_[offsets_[i], offsets_[i + 1]).
+        Arena arena_;
+        KeyIndex keys_index_;
+        std::vector<std::string_view> keys_;
+        std::vector<uint32_t> offsets_;
+        std::vector<uint32_t> postings_;
+
+        void Add(const Node& section, uint32_t parent, std::vector<uint32_t>& key_ids);
+
+    public:
+
+        // root is the root section node of a tree with the given base.
+        PathIndex(const Node& root, uintptr_t base);
+
+        PathIndex(const PathIndex&) = delete;
+
+        PathIndex& operator=(const PathIndex&) = delete;
+
+        uintptr_t base() const {
+            return base_;
+        }
+
+        // Entries of every member named key, in document order.
+        std::pair<const uint32_t*, const uint32_t*> Find(std::string_view key) const;
+
+        const Node& NodeAt(uint32_t entry) const {
+            return *entries_[entry].node;
+        }
+
+        // Keys of the sections above an entry, from the root down, without its own.
+        void AppendAncestors(uint32_t entry, std::vector<std::string_view>& keys) const;
+
+    };
+
+    // Section::Query for the tree with the given root and base. index, which may be
+    // null, must have been built from that tree.
+    std::vector<QueryMatch> RunQuery(const Node& root, uintptr_t base, const PathIndex* index,
+                                     std::string_view pattern);
+}
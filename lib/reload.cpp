@@ -0,0 +1,166 @@
+#include "reload.h"
+
+#include "key_index.h"
+#include "scanner.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace omfl;
+
+namespace {
+
+    // Cuts text right before section headers. A header starts a new piece once the
+    // current one has min_size bytes and the header hashes to a multiple of four, so
+    // the cuts depend on the text around them and an edit moves few of them.
+    std::vector<std::string_view> SplitAtHeaders(std::string_view text, size_t min_size, size_t max_size) {
+        std::vector<std::string_view> pieces;
+        size_t piece_begin = 0;
+        ForEachHeaderLine(text, 0, [&](size_t line_begin, size_t line_end) {
+            size_t size = line_begin - piece_begin;
+            std::string_view line = text.substr(line_begin, line_end - line_begin);
+            if (size >= min_size && (size >= max_size || (HashKey(line) & 3) == 0)) {
+                pieces.push_back(text.substr(piece_begin, size));
+                piece_begin = line_begin;
+            }
+            return true;
+        });
+        pieces.push_back(text.substr(piece_begin));
+        return pieces;
+    }
+}
+
+ReloadableDocument::ReloadableDocument(std::filesystem::path path) : path_(std::move(path)) {
+    std::atomic_store(&current_, std::shared_ptr<const Section>(std::make_shared<Document>()));
+    Reload();
+}
+
+ReloadableDocument::~ReloadableDocument() {
+    StopWatching();
+}
+
+bool ReloadableDocument::Reload() {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+
+    std::string text;
+    {
+        std::ifstream file(path_, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::unordered_map<size_t, Piece> pieces;
+    std::vector<std::shared_ptr<const Section>> sections;
+    for (std::string_view piece_text : SplitAtHeaders(text, kMinPieceSize, kMaxPieceSize)) {
+        size_t hash = std::hash<std::string_view>()(piece_text);
+        auto cached = pieces_.find(hash);
+        auto parsed = pieces.find(hash);
+        if (parsed != pieces.end() && parsed->second.text == piece_text) {
+            sections.push_back(parsed->second.section);
+        } else if (cached != pieces_.end() && cached->second.text == piece_text) {
+            sections.push_back(cached->second.section);
+            pieces.emplace(hash, std::move(cached->second));
+            pieces_.erase(cached);
+        } else {
+            Piece piece{std::string(piece_text), nullptr};
+            piece.section = std::make_shared<Document>(parse(piece.text));
+            sections.push_back(piece.section);
+            pieces.emplace(hash, std::move(piece));
+        }
+    }
+    pieces_ = std::move(pieces);
+
+    std::shared_ptr<const Section> next = std::make_shared<Document>(merge(sections));
+    if (!next->valid() && Current()->valid()) {
+        return false;
+    }
+    std::atomic_store(&current_, std::move(next));
+    return true;
+}
+
+void ReloadableDocument::Watch(std::function<void(std::shared_ptr<const Section>)> on_reload) {
+    StopWatching();
+    stop_ = false;
+    watcher_ = std::thread([this, on_reload = std::move(on_reload)] {
+        WatchLoop(on_reload);
+    });
+}
+
+void ReloadableDocument::StopWatching() {
+    if (watcher_.joinable()) {
+        stop_ = true;
+        watcher_.join();
+    }
+}
+
+#ifdef __linux__
+
+void ReloadableDocument::WatchLoop(const std::function<void(std::shared_ptr<const Section>)>& on_reload) {
+    // The directory is watched rather than the file, so editors that save by writing a
+    // new file and renaming it over the old one are noticed as well. A file is only read
+    // once it has been closed or moved into place: at creation it is still empty, and an
+    // empty text would parse as a valid document that replaces the current one.
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    std::filesystem::path directory = path_.parent_path().empty() ? "." : path_.parent_path();
+    std::string name = path_.filename().string();
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return;
+    }
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (!stop_) {
+        pollfd request{fd, POLLIN, 0};
+        if (poll(&request, 1, 100) <= 0) {
+            continue;
+        }
+        bool changed = false;
+        ssize_t size;
+        while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < size;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                if (event->len != 0 && name == event->name) {
+                    changed = true;
+                }
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+        if (changed && Reload() && on_reload) {
+            on_reload(Current());
+        }
+    }
+    close(fd);
+}
+
+#else
+
+void ReloadableDocument::WatchLoop(const std::function<void(std::shared_ptr<const Section>)>& on_reload) {
+    std::error_code error;
+    auto last_write = std::filesystem::last_write_time(path_, error);
+    while (!stop_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto write = std::filesystem::last_write_time(path_, error);
+        if (error || write == last_write) {
+            continue;
+        }
+        last_write = write;
+        if (Reload() && on_reload) {
+            on_reload(Current());
+        }
+    }
+}
+
+#endif
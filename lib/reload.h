@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "parser.h"
+
+
+namespace omfl {
+
+    // A document that follows its file. Readers take a snapshot with Current() and can
+    // use it for as long as they hold it. Reload builds the next version beside it and
+    // publishes it with one atomic pointer swap, so readers never wait for a reload and
+    // never see a half-built tree.
+    //
+    // The text is cut into pieces at section headers and every piece is parsed on its
+    // own, so a reload only parses the pieces whose text changed and merges the others
+    // as they were.
+    class ReloadableDocument {
+    private:
+
+        static constexpr size_t kMinPieceSize = 4 * 1024;
+        static constexpr size_t kMaxPieceSize = 256 * 1024;
+
+        struct Piece {
+            std::string text;
+            std::shared_ptr<const Section> section;
+        };
+
+        std::filesystem::path path_;
+        // Only accessed through std::atomic_load and std::atomic_store.
+        std::shared_ptr<const Section> current_;
+
+        // Parsed pieces of the last loaded text, by hash of their text.
+        std::unordered_map<size_t, Piece> pieces_;
+        std::mutex reload_mutex_;
+
+        std::thread watcher_;
+        std::atomic<bool> stop_{false};
+
+        void WatchLoop(const std::function<void(std::shared_ptr<const Section>)>& on_reload);
+
+    public:
+
+        explicit ReloadableDocument(std::filesystem::path path);
+
+        ReloadableDocument(const ReloadableDocument&) = delete;
+
+        ReloadableDocument& operator=(const ReloadableDocument&) = delete;
+
+        ~ReloadableDocument();
+
+        std::shared_ptr<const Section> Current() const {
+            return std::atomic_load(&current_);
+        }
+
+        // Reads the file again and publishes the new document. A text that does not parse
+        // is not published while the current document is valid. Returns whether a new
+        // version was published.
+        bool Reload();
+
+        // Calls Reload on a background thread whenever the file changes: through inotify
+        // on Linux, by polling its modification time elsewhere. on_reload gets every
+        // published version.
+        void Watch(std::function<void(std::shared_ptr<const Section>)> on_reload = {});
+
+        void StopWatching();
+
+    };
+}
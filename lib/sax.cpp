@@ -0,0 +1,116 @@
+#include "sax.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+using namespace omfl;
+
+namespace {
+
+    constexpr size_t kReadSize = 64 * 1024;
+}
+
+SaxParser::SaxParser(SaxHandler& handler) : handler_(handler), tokenizer_(*this) {
+}
+
+void SaxParser::OnSection(std::string_view path) {
+    handler_.OnSection(path);
+}
+
+bool SaxParser::OnKey(std::string_view key) {
+    return handler_.OnKey(key);
+}
+
+void SaxParser::OnInt(int64_t value) {
+    handler_.OnInt(value);
+}
+
+void SaxParser::OnFloat(double value) {
+    handler_.OnFloat(value);
+}
+
+void SaxParser::OnBool(bool value) {
+    handler_.OnBool(value);
+}
+
+void SaxParser::OnString(std::string_view value) {
+    handler_.OnString(value);
+}
+
+void SaxParser::OnArrayBegin() {
+    handler_.OnArrayBegin();
+}
+
+void SaxParser::OnArrayEnd() {
+    handler_.OnArrayEnd();
+}
+
+void SaxParser::OnError(ErrorKind kind, std::string_view span) {
+    valid_ = false;
+    stopped_ = !handler_.OnError(lines_.Locate(kind, span));
+}
+
+void SaxParser::Parse(std::string_view text) {
+    lines_ = LineCounter(text, line_);
+    tokenizer_.ParseText(text);
+    line_ += std::count(text.begin(), text.end(), '\n');
+}
+
+void SaxParser::Feed(std::string_view chunk) {
+    if (stopped_) {
+        return;
+    }
+    if (!carry_.empty()) {
+        // The first line of the chunk completes the line carried over.
+        size_t newline = chunk.find('\n');
+        if (newline == std::string_view::npos) {
+            carry_.append(chunk);
+            return;
+        }
+        carry_.append(chunk.substr(0, newline + 1));
+        Parse(carry_);
+        carry_.clear();
+        chunk.remove_prefix(newline + 1);
+        if (stopped_) {
+            return;
+        }
+    }
+
+    // Whole lines are parsed where they are, the rest waits for the next chunk.
+    size_t newline = chunk.rfind('\n');
+    if (newline != std::string_view::npos) {
+        Parse(chunk.substr(0, newline + 1));
+        chunk.remove_prefix(newline + 1);
+    }
+    carry_.assign(chunk);
+}
+
+void SaxParser::Finish() {
+    if (!carry_.empty() && !stopped_) {
+        Parse(carry_);
+        carry_.clear();
+    }
+}
+
+bool omfl::parse(const std::string& code, SaxHandler& handler) {
+    SaxParser parser(handler);
+    parser.Feed(code);
+    parser.Finish();
+    return parser.valid();
+}
+
+bool omfl::parse(const std::filesystem::path& path, SaxHandler& handler) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    SaxParser parser(handler);
+    std::unique_ptr<char[]> buffer(new char[kReadSize]);
+    while (file) {
+        file.read(buffer.get(), kReadSize);
+        parser.Feed(std::string_view(buffer.get(), static_cast<size_t>(file.gcount())));
+    }
+    parser.Finish();
+    return parser.valid();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "tokenizer.h"
+
+
+namespace omfl {
+
+    // Receives the contents of an OMFL text in order of appearance. Every event has an
+    // empty default, so a handler only overrides what it needs. Views passed to events
+    // are only valid during the call.
+    //
+    // A value is reported as OnKey followed by one scalar event, or by OnArrayBegin, the
+    // elements and OnArrayEnd. Lines are only checked on their own: duplicate keys, a
+    // reopened section and a section named like a value are reported as they come, and
+    // it is up to the handler to treat them as errors.
+    class SaxHandler {
+    public:
+
+        virtual ~SaxHandler() = default;
+
+        // A section header; path is its dotted name without the brackets.
+        virtual void OnSection(std::string_view /*path*/) {
+        }
+
+        // Start of a value in the current section. Returning false skips the value.
+        virtual bool OnKey(std::string_view /*key*/) {
+            return true;
+        }
+
+        virtual void OnInt(int64_t /*value*/) {
+        }
+
+        virtual void OnFloat(double /*value*/) {
+        }
+
+        virtual void OnBool(bool /*value*/) {
+        }
+
+        // Contents of a string without the quotes.
+        virtual void OnString(std::string_view /*value*/) {
+        }
+
+        virtual void OnArrayBegin() {
+        }
+
+        virtual void OnArrayEnd() {
+        }
+
+        // A malformed line. The events of a malformed value up to the problem come first.
+        // Returning false stops the parse: the rest of the text is ignored.
+        virtual bool OnError(const ParseError& /*error*/) {
+            return true;
+        }
+
+    };
+
+    // Push parser: text is fed in chunks of any size, cut anywhere, and events are sent
+    // to the handler as soon as a line is complete. Only an unfinished last line is
+    // buffered, so memory does not grow with the size of the document. Once the handler
+    // has asked to stop, further chunks are ignored.
+    class SaxParser {
+    private:
+
+        SaxHandler& handler_;
+        Tokenizer<SaxParser> tokenizer_;
+        // Beginning of a line cut by the end of the previous chunk.
+        std::string carry_;
+        // Number of the first line of the text parsed next.
+        size_t line_ = 1;
+        LineCounter lines_;
+        bool valid_ = true;
+        bool stopped_ = false;
+
+        friend class Tokenizer<SaxParser>;
+
+        void OnSection(std::string_view path);
+
+        bool OnKey(std::string_view key);
+
+        void OnInt(int64_t value);
+
+        void OnFloat(double value);
+
+        void OnBool(bool value);
+
+        void OnString(std::string_view value);
+
+        void OnArrayBegin();
+
+        void OnArrayEnd();
+
+        void OnError(ErrorKind kind, std::string_view span);
+
+        bool Stopped() const {
+            return stopped_;
+        }
+
+        // Parses whole lines and counts them.
+        void Parse(std::string_view text);
+
+    public:
+
+        explicit SaxParser(SaxHandler& handler);
+
+        SaxParser(const SaxParser&) = delete;
+
+        SaxParser& operator=(const SaxParser&) = delete;
+
+        void Feed(std::string_view chunk);
+
+        // Parses the last line if the text does not end with a newline.
+        void Finish();
+
+        // False once a malformed line has been seen.
+        bool valid() const {
+            return valid_;
+        }
+
+    };
+
+    // Sends the events of a whole text to handler. Returns false if it has a malformed line.
+    bool parse(const std::string& code, SaxHandler& handler);
+
+    // Reads the file in fixed-size chunks. Returns false if it cannot be read or has a
+    // malformed line.
+    bool parse(const std::filesystem::path& path, SaxHandler& handler);
+}
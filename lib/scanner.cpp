@@ -0,0 +1,157 @@
+#include "scanner.h"
+
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OMFL_SCANNER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define OMFL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OMFL_TARGET_AVX2
+#endif
+
+using namespace omfl;
+
+namespace {
+
+    size_t ScanScalar(const char* data, size_t begin, size_t end, uint32_t* positions) {
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (IsStructural(data[i])) {
+                positions[count++] = static_cast<uint32_t>(i);
+            }
+        }
+        return count;
+    }
+
+#ifdef OMFL_SCANNER_X86
+
+    inline uint32_t CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    inline size_t EmitMask(uint32_t mask, size_t offset, uint32_t* positions) {
+        size_t count = 0;
+        while (mask != 0) {
+            positions[count++] = static_cast<uint32_t>(offset + CountTrailingZeros(mask));
+            mask &= mask - 1;
+        }
+        return count;
+    }
+
+    size_t ScanSse2(const char* data, size_t size, uint32_t* positions) {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i hash = _mm_set1_epi8('#');
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i open = _mm_set1_epi8('[');
+        const __m128i close = _mm_set1_epi8(']');
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i equal = _mm_set1_epi8('=');
+
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, hash)),
+                             _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, open))),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, close), _mm_cmpeq_epi8(chunk, comma)),
+                             _mm_cmpeq_epi8(chunk, equal)));
+            count += EmitMask(static_cast<uint32_t>(_mm_movemask_epi8(hits)), i, positions + count);
+        }
+        return count + ScanScalar(data, i, size, positions + count);
+    }
+
+    OMFL_TARGET_AVX2 size_t ScanAvx2(const char* data, size_t size, uint32_t* positions) {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i hash = _mm256_set1_epi8('#');
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i open = _mm256_set1_epi8('[');
+        const __m256i close = _mm256_set1_epi8(']');
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i equal = _mm256_set1_epi8('=');
+
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newline), _mm256_cmpeq_epi8(chunk, hash)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, open))),
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, close), _mm256_cmpeq_epi8(chunk, comma)),
+                                _mm256_cmpeq_epi8(chunk, equal)));
+            count += EmitMask(static_cast<uint32_t>(_mm256_movemask_epi8(hits)), i, positions + count);
+        }
+        return count + ScanScalar(data, i, size, positions + count);
+    }
+
+    bool HasAvx2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#endif
+
+    using ScanFunction = size_t (*)(const char*, size_t, uint32_t*);
+
+    struct Scanner {
+        ScanFunction scan;
+        const char* name;
+    };
+
+    size_t ScanAll(const char* data, size_t size, uint32_t* positions) {
+        return ScanScalar(data, 0, size, positions);
+    }
+
+    Scanner SelectScanner() {
+        const char* forced = std::getenv("OMFL_SCANNER");
+        std::string_view requested = forced == nullptr ? "" : forced;
+        if (requested == "scalar") {
+            return {ScanAll, "scalar"};
+        }
+#ifdef OMFL_SCANNER_X86
+        if (requested != "sse2" && HasAvx2()) {
+            return {ScanAvx2, "avx2"};
+        }
+        return {ScanSse2, "sse2"};
+#else
+        return {ScanAll, "scalar"};
+#endif
+    }
+
+    const Scanner& ActiveScanner() {
+        static const Scanner scanner = SelectScanner();
+        return scanner;
+    }
+}
+
+size_t omfl::FindStructurals(std::string_view text, uint32_t* positions) {
+    return ActiveScanner().scan(text.data(), text.size(), positions);
+}
+
+const char* omfl::StructuralScannerName() {
+    return ActiveScanner().name;
+}
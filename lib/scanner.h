@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+namespace omfl {
+
+    // Characters the line grammar is built around: '\n', '#', '"', '[', ']', ',' and '='.
+    inline bool IsStructural(char c) {
+        return c == '\n' || c == '#' || c == '"' || c == '[' || c == ']' || c == ',' || c == '=';
+    }
+
+    // A line whose first non-blank character opens a section header. Documents can be cut
+    // right before such lines: no value spans more than one line.
+    inline bool IsHeaderLine(std::string_view line) {
+        size_t first = line.find_first_not_of(' ');
+        return first != std::string_view::npos && line[first] == '[';
+    }
+
+    // Calls on_line(begin, end) for every header line of text, from the line that starts
+    // at offset `from` on. begin and end are the offsets of the line without its '\n', and
+    // on_line returns false to stop there. Every pass that cuts a document at its section
+    // headers walks the text through this.
+    template<typename OnLine>
+    void ForEachHeaderLine(std::string_view text, size_t from, OnLine&& on_line) {
+        for (size_t begin = from; begin < text.size();) {
+            size_t end = text.find('\n', begin);
+            end = end == std::string_view::npos ? text.size() : end;
+            if (IsHeaderLine(text.substr(begin, end - begin)) && !on_line(begin, end)) {
+                return;
+            }
+            begin = end + 1;
+        }
+    }
+
+    // Writes the offsets of all structural characters of text, in order, to positions
+    // and returns how many there were. positions must have room for text.size() entries.
+    // text.size() must fit in uint32_t. Uses AVX2 or SSE2 when the CPU has them; the
+    // OMFL_SCANNER environment variable ("scalar" or "sse2") caps that choice.
+    size_t FindStructurals(std::string_view text, uint32_t* positions);
+
+    // Name of the implementation FindStructurals dispatches to: "avx2", "sse2" or "scalar".
+    const char* StructuralScannerName();
+}
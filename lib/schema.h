@@ -0,0 +1,332 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "errors.h"
+#include "mapped_file.h"
+#include "tokenizer.h"
+
+
+namespace omfl {
+
+    // Binds the value at a dotted path to a member of Struct.
+    template<typename Struct, typename Member>
+    struct Field {
+        std::string_view path;
+        Member Struct::* member;
+    };
+
+    template<typename Struct, typename Member>
+    constexpr Field<Struct, Member> Bind(std::string_view path, Member Struct::* member) {
+        return {path, member};
+    }
+
+    // Specialized for every struct filled by parse_into, with a constexpr tuple of fields:
+    //
+    //     template<>
+    //     struct omfl::Schema<Server> {
+    //         static constexpr auto kFields = std::make_tuple(
+    //             Bind("server.port", &Server::port),
+    //             Bind("server.hosts", &Server::hosts));
+    //     };
+    //
+    // Members can be integers, floating point numbers, bool, std::string and std::vector
+    // of those.
+    template<typename T>
+    struct Schema;
+
+    namespace schema {
+
+        template<typename T>
+        struct IsVector : std::false_type {
+        };
+
+        template<typename T>
+        struct IsVector<std::vector<T>> : std::true_type {
+        };
+
+        template<typename T>
+        constexpr bool kIsScalar = std::is_arithmetic_v<T> || std::is_same_v<T, std::string>;
+
+        template<typename T>
+        constexpr bool IsBindable() {
+            if constexpr (IsVector<T>::value) {
+                return kIsScalar<typename T::value_type>;
+            } else {
+                return kIsScalar<T>;
+            }
+        }
+
+        template<typename T>
+        bool AssignScalar(T& slot, int64_t value) {
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+                if constexpr (std::is_signed_v<T>) {
+                    if (value < std::numeric_limits<T>::min() || value > std::numeric_limits<T>::max()) {
+                        return false;
+                    }
+                } else {
+                    if (value < 0 || static_cast<uint64_t>(value) > std::numeric_limits<T>::max()) {
+                        return false;
+                    }
+                }
+                slot = static_cast<T>(value);
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        template<typename T>
+        bool AssignScalar(T& slot, double value) {
+            if constexpr (std::is_floating_point_v<T>) {
+                slot = static_cast<T>(value);
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        template<typename T>
+        bool AssignScalar(T& slot, bool value) {
+            if constexpr (std::is_same_v<T, bool>) {
+                slot = value;
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        template<typename T>
+        bool AssignScalar(T& slot, std::string_view value) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                slot.assign(value);
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        // Tokenizer handler that stores the values of the schema paths straight into the
+        // members they are bound to. Every other value is skipped unparsed.
+        template<typename T>
+        class Binder {
+        private:
+
+            static constexpr auto& kFields = Schema<T>::kFields;
+            static constexpr size_t kCount = std::tuple_size_v<std::decay_t<decltype(kFields)>>;
+            static constexpr size_t kNone = kCount;
+
+            T& target_;
+            std::string_view section_;
+            std::string_view key_;
+            // Field of the value being parsed, kNone once it is known not to fit.
+            size_t field_ = kNone;
+            size_t depth_ = 0;
+            std::array<bool, kCount> seen_{};
+
+            LineCounter lines_;
+            std::vector<ParseError>& errors_;
+            bool stop_at_first_error_;
+
+            friend class Tokenizer<Binder>;
+
+            template<size_t... I>
+            static constexpr bool AllBindable(std::index_sequence<I...>) {
+                return (IsBindable<std::decay_t<decltype(std::declval<T&>().*std::get<I>(kFields).member)>>() && ...);
+            }
+
+            static_assert(AllBindable(std::make_index_sequence<kCount>()),
+                          "Schema members must be integers, floating point numbers, bool, std::string or vectors of those");
+
+            // Whether `path` is `section`.`key`, or just `key` in the root section.
+            static bool Matches(std::string_view path, std::string_view section, std::string_view key) {
+                if (section.empty()) {
+                    return path == key;
+                }
+                return path.size() == section.size() + 1 + key.size() && path[section.size()] == '.' &&
+                       path.substr(0, section.size()) == section && path.substr(section.size() + 1) == key;
+            }
+
+            template<size_t... I>
+            size_t FindField(std::string_view key, std::index_sequence<I...>) const {
+                size_t field = kNone;
+                static_cast<void>(((Matches(std::get<I>(kFields).path, section_, key) ? (field = I, true) : false) || ...));
+                return field;
+            }
+
+            // Calls visit with the member bound to field.
+            template<typename Visit, size_t... I>
+            void VisitField(size_t field, Visit& visit, std::index_sequence<I...>) {
+                ((field == I ? visit(target_.*std::get<I>(kFields).member) : void()), ...);
+            }
+
+            template<typename Visit>
+            void VisitField(Visit&& visit) {
+                VisitField(field_, visit, std::make_index_sequence<kCount>());
+            }
+
+            void Error(ErrorKind kind, std::string_view span) {
+                errors_.push_back(lines_.Locate(kind, span));
+            }
+
+            // Fields whose path the text did not have, after its own errors and without a
+            // position.
+            template<size_t... I>
+            void ReportMissing(std::index_sequence<I...>) {
+                ((seen_[I] ? void() : MissingError(std::get<I>(kFields).path)), ...);
+            }
+
+            void MissingError(std::string_view path) {
+                if (Stopped()) {
+                    return;
+                }
+                ParseError error;
+                error.kind = ErrorKind::kMissingKey;
+                error.text = path;
+                errors_.push_back(std::move(error));
+            }
+
+            void Mismatch() {
+                Error(ErrorKind::kTypeMismatch, key_);
+                field_ = kNone;
+            }
+
+            template<typename Value>
+            void Set(Value value) {
+                if (field_ == kNone) {
+                    return;
+                }
+                VisitField([this, value](auto& member) {
+                    using Member = std::decay_t<decltype(member)>;
+                    if constexpr (IsVector<Member>::value) {
+                        if (depth_ != 1) {
+                            Mismatch();
+                            return;
+                        }
+                        typename Member::value_type element{};
+                        if (!AssignScalar(element, value)) {
+                            Mismatch();
+                            return;
+                        }
+                        member.push_back(std::move(element));
+                    } else if (depth_ != 0 || !AssignScalar(member, value)) {
+                        Mismatch();
+                    }
+                });
+            }
+
+            void OnSection(std::string_view path) {
+                section_ = path;
+            }
+
+            bool OnKey(std::string_view key) {
+                field_ = FindField(key, std::make_index_sequence<kCount>());
+                if (field_ == kNone) {
+                    return false;
+                }
+                if (seen_[field_]) {
+                    Error(ErrorKind::kDuplicateKey, key);
+                    field_ = kNone;
+                    return false;
+                }
+                seen_[field_] = true;
+                key_ = key;
+                depth_ = 0;
+                return true;
+            }
+
+            void OnInt(int64_t value) {
+                Set(value);
+            }
+
+            void OnFloat(double value) {
+                Set(value);
+            }
+
+            void OnBool(bool value) {
+                Set(value);
+            }
+
+            void OnString(std::string_view value) {
+                Set(value);
+            }
+
+            void OnArrayBegin() {
+                if (field_ != kNone) {
+                    VisitField([this](auto& member) {
+                        using Member = std::decay_t<decltype(member)>;
+                        if constexpr (IsVector<Member>::value) {
+                            if (depth_ == 0) {
+                                member.clear();
+                                return;
+                            }
+                        }
+                        Mismatch();
+                    });
+                }
+                depth_++;
+            }
+
+            void OnArrayEnd() {
+                depth_--;
+            }
+
+            void OnError(ErrorKind kind, std::string_view span) {
+                Error(kind, span);
+            }
+
+            bool Stopped() const {
+                return stop_at_first_error_ && !errors_.empty();
+            }
+
+        public:
+
+            Binder(T& target, std::vector<ParseError>& errors, bool stop_at_first_error)
+                : target_(target), errors_(errors), stop_at_first_error_(stop_at_first_error) {
+            }
+
+            void Parse(std::string_view text) {
+                lines_ = LineCounter(text);
+                Tokenizer<Binder>(*this).ParseText(text);
+                ReportMissing(std::make_index_sequence<kCount>());
+            }
+
+        };
+    }
+
+    // Fills the members of target bound by Schema<T> in one pass over the text, without
+    // building a document. Values outside the schema are skipped without being checked.
+    // Returns the errors in text order, which include values that do not fit their
+    // member, followed by a kMissingKey error for every path the text does not have;
+    // target may be partly filled then.
+    template<typename T>
+    std::vector<ParseError> parse_into(const std::string& code, T& target, bool stop_at_first_error = false) {
+        std::vector<ParseError> errors;
+        schema::Binder<T>(target, errors, stop_at_first_error).Parse(code);
+        return errors;
+    }
+
+    // Reads the file through a memory mapping.
+    template<typename T>
+    std::vector<ParseError> parse_into(const std::filesystem::path& path, T& target, bool stop_at_first_error = false) {
+        std::vector<ParseError> errors;
+        MappedFile file(path);
+        if (!file.valid()) {
+            errors.emplace_back();
+            errors.back().kind = ErrorKind::kUnreadableFile;
+            return errors;
+        }
+        schema::Binder<T>(target, errors, stop_at_first_error).Parse(file.bytes());
+        return errors;
+    }
+}
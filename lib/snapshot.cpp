@@ -0,0 +1,196 @@
+#include "snapshot.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+using namespace omfl;
+
+namespace {
+
+    constexpr char kMagic[8] = {'O', 'M', 'F', 'L', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t kVersion = 2;
+    constexpr uint32_t kByteOrder = 0x01020304;
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t source_hash;
+        uint64_t image_size;
+        // Offset of the root node.
+        uint64_t root;
+    };
+
+    // Lays a tree out as one image. Nodes and tables are placed as they are reached, and
+    // every address in them is rewritten as an offset from the start of the image.
+    class ImageWriter {
+    private:
+
+        std::string image_;
+        std::unordered_map<std::string_view, uint64_t> strings_;
+        uintptr_t base_;
+
+        size_t Reserve(size_t size, size_t align) {
+            size_t offset = (image_.size() + align - 1) / align * align;
+            image_.resize(offset + size);
+            return offset;
+        }
+
+        template<typename T>
+        void Store(size_t offset, const T& value) {
+            std::memcpy(&image_[offset], &value, sizeof(T));
+        }
+
+        uint64_t Intern(std::string_view string) {
+            if (string.empty()) {
+                return 0;
+            }
+            auto [it, inserted] = strings_.emplace(string, image_.size());
+            if (inserted) {
+                image_.append(string);
+            }
+            return it->second;
+        }
+
+        void WriteNode(size_t offset, const Node& node) {
+            Node copy = node;
+            copy.key = Intern(node.Key(base_));
+            if (node.type == NodeType::kString) {
+                copy.offset = Intern(node.String(base_));
+            } else if (node.packed != NodeType::kNone) {
+                copy.offset = Reserve(node.PackedBytes(), alignof(int64_t));
+                std::memcpy(&image_[copy.offset], node.Ints(base_), node.PackedBytes());
+            } else if (node.type == NodeType::kArray) {
+                size_t elements = Reserve(node.size * sizeof(Node), alignof(Node));
+                copy.offset = elements;
+                for (size_t i = 0; i < node.size; i++) {
+                    WriteNode(elements + i * sizeof(Node), node.Elements(base_)[i]);
+                }
+            } else if (node.type == NodeType::kSection) {
+                const SectionBody* source = node.Body(base_);
+                SectionBody body = *source;
+                size_t table_size = body.index.TableBytes();
+                if (table_size != 0) {
+                    size_t table = Reserve(table_size, alignof(uint32_t));
+                    std::memcpy(&image_[table], source->index.Table(base_), table_size);
+                    body.index.MoveTable(table);
+                }
+                size_t members = Reserve(node.size * sizeof(Node), alignof(Node));
+                body.members = members;
+                copy.offset = Reserve(sizeof(SectionBody), alignof(SectionBody));
+                Store(copy.offset, body);
+                for (size_t i = 0; i < node.size; i++) {
+                    WriteNode(members + i * sizeof(Node), source->Members(base_)[i]);
+                }
+            }
+            Store(offset, copy);
+        }
+
+    public:
+
+        explicit ImageWriter(uintptr_t base) : base_(base) {
+        }
+
+        std::string Write(const Node& root, uint64_t source_hash) {
+            size_t header = Reserve(sizeof(SnapshotHeader), alignof(SnapshotHeader));
+            size_t root_offset = Reserve(sizeof(Node), alignof(Node));
+            WriteNode(root_offset, root);
+
+            SnapshotHeader value{};
+            std::memcpy(value.magic, kMagic, sizeof(kMagic));
+            value.version = kVersion;
+            value.byte_order = kByteOrder;
+            value.source_hash = source_hash;
+            value.image_size = image_.size();
+            value.root = root_offset;
+            Store(header, value);
+            return std::move(image_);
+        }
+
+    };
+}
+
+uint64_t omfl::HashSource(std::string_view text) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ text.size();
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + i, sizeof(word));
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    // An empty text may have no data pointer at all, which memcpy must not get.
+    if (i < text.size()) {
+        std::memcpy(&tail, text.data() + i, text.size() - i);
+    }
+    hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+    return hash ^ (hash >> 29);
+}
+
+bool omfl::save_snapshot(const Section& document, const std::filesystem::path& snapshot, uint64_t source_hash) {
+    if (!document.valid()) {
+        return false;
+    }
+    std::string image = ImageWriter(document.base()).Write(document.node(), source_hash);
+
+    // Written next to the target and renamed over it, so a process that has the old
+    // snapshot mapped keeps reading a complete file.
+    std::filesystem::path temporary = snapshot;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(image.data(), static_cast<std::streamsize>(image.size()));
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, snapshot, error);
+    return !error;
+}
+
+std::optional<Document> omfl::load_snapshot(const std::filesystem::path& snapshot, uint64_t source_hash) {
+    auto file = std::make_shared<MappedFile>(snapshot, false);
+    std::string_view bytes = file->bytes();
+    if (!file->valid() || bytes.size() < sizeof(SnapshotHeader)) {
+        return std::nullopt;
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.byte_order != kByteOrder || header.source_hash != source_hash || header.image_size != bytes.size() ||
+        header.root % alignof(Node) != 0 || header.root + sizeof(Node) > bytes.size()) {
+        return std::nullopt;
+    }
+
+    std::optional<Document> document(std::in_place);
+    document->arena_owner_->Hold(file);
+    document->base_ = reinterpret_cast<uintptr_t>(bytes.data());
+    document->node_ = reinterpret_cast<const Node*>(bytes.data() + header.root);
+    return document;
+}
+
+Document omfl::parse_cached(const std::filesystem::path& source, const std::filesystem::path& snapshot) {
+    MappedFile text(source);
+    if (!text.valid()) {
+        return parse(source);
+    }
+    uint64_t hash = HashSource(text.bytes());
+    if (std::optional<Document> document = load_snapshot(snapshot, hash)) {
+        return std::move(*document);
+    }
+
+    ParseOptions options;
+    options.map_file = true;
+    Document document = parse(source, options);
+    // The file is mapped a second time by parse. If it changed in between, the document
+    // no longer matches the hash and is not worth saving.
+    if (HashSource(MappedFile(source).bytes()) == hash) {
+        save_snapshot(document, snapshot, hash);
+    }
+    return document;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "parser.h"
+
+
+namespace omfl {
+
+    // 64-bit hash of a source text. Snapshots store it to recognize the text they were made from.
+    uint64_t HashSource(std::string_view text);
+
+    // Writes a valid document as a snapshot image: one flat table of nodes, section index
+    // tables and a pool of deduplicated strings, all addressed relative to the start of
+    // the file. Returns false for invalid documents and when the file cannot be written.
+    bool save_snapshot(const Section& document, const std::filesystem::path& snapshot, uint64_t source_hash);
+
+    // Maps a snapshot and returns the document stored in it, which is read in place without
+    // any decoding. Returns nothing when the file is missing, is not a snapshot of this
+    // format version or was made from a text with another hash. The contents of the image
+    // are trusted: a snapshot modified by hand can crash the reader.
+    std::optional<Document> load_snapshot(const std::filesystem::path& snapshot, uint64_t source_hash);
+
+    // Loads `source` from `snapshot` if the snapshot was made from the current contents of
+    // the file. Otherwise parses the file and writes a fresh snapshot for the next time.
+    Document parse_cached(const std::filesystem::path& source, const std::filesystem::path& snapshot);
+}
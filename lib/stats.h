@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+
+// Statistics are only collected in builds configured with -DOMFL_ENABLE_STATS=ON.
+// Otherwise every OMFL_STATS statement compiles to nothing.
+#ifdef OMFL_ENABLE_STATS
+#define OMFL_STATS(...) __VA_ARGS__
+#else
+#define OMFL_STATS(...)
+#endif
+
+
+namespace omfl {
+
+    struct ParseStats {
+        uint64_t bytes = 0;
+        uint64_t lines = 0;
+        // Section headers, counted once per header line.
+        uint64_t sections = 0;
+        uint64_t keys = 0;
+        uint64_t array_elements = 0;
+
+        // Splitting lines and checking their syntax, turning scalars into numbers and
+        // strings, and everything done with the results: building, merging and freezing
+        // the tree. A parse on several threads adds up the time of all of them. Timing
+        // reads the clock around every event, so a timed parse is slower than usual.
+        uint64_t tokenize_ns = 0;
+        uint64_t convert_ns = 0;
+        uint64_t build_ns = 0;
+
+        // Bytes of the arena plus the section builders, taken when the tree is frozen:
+        // nothing of the tree is freed before that.
+        uint64_t peak_node_bytes = 0;
+        // Most keys compared or index slots probed by one member lookup of the parse.
+        uint32_t longest_find_scan = 0;
+
+        ParseStats& operator+=(const ParseStats& other) {
+            bytes += other.bytes;
+            lines += other.lines;
+            sections += other.sections;
+            keys += other.keys;
+            array_elements += other.array_elements;
+            tokenize_ns += other.tokenize_ns;
+            convert_ns += other.convert_ns;
+            build_ns += other.build_ns;
+            peak_node_bytes += other.peak_node_bytes;
+            longest_find_scan = std::max(longest_find_scan, other.longest_find_scan);
+            return *this;
+        }
+    };
+
+    // Charges the time between two switches to the phase that was running. Does nothing
+    // until it is attached to stats.
+    class PhaseClock {
+    private:
+
+        ParseStats* stats_ = nullptr;
+        uint64_t* phase_ = nullptr;
+        std::chrono::steady_clock::time_point start_;
+
+    public:
+
+        void Attach(ParseStats& stats) {
+            stats_ = &stats;
+        }
+
+        ParseStats* stats() const {
+            return stats_;
+        }
+
+        // Starts `phase`, a time member of ParseStats, or stops timing when it is null.
+        void Switch(uint64_t ParseStats::* phase) {
+            if (stats_ == nullptr) {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (phase_ != nullptr) {
+                *phase_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+            }
+            phase_ = phase == nullptr ? nullptr : &(stats_->*phase);
+            start_ = now;
+        }
+
+    };
+}
@@ -0,0 +1,91 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace omfl;
+
+ThreadPool::ThreadPool(size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        workers_.emplace_back([this] { Work(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    task_added_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::DefaultSize() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::Work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            task_added_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+            running_++;
+        }
+        task();
+        {
+            std::lock_guard lock(mutex_);
+            running_--;
+        }
+        task_done_.notify_all();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push(std::move(task));
+    }
+    task_added_.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock lock(mutex_);
+    task_done_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    size_t tasks = std::min(count, Size());
+    for (size_t t = 0; t < tasks; t++) {
+        Submit([&] {
+            for (size_t i = next++; i < count; i = next++) {
+                try {
+                    body(i);
+                } catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        });
+    }
+    Wait();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+namespace omfl {
+
+    class ThreadPool {
+    private:
+
+        std::vector<std::thread> workers_;
+        std::queue<std::function<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable task_added_;
+        std::condition_variable task_done_;
+        size_t running_ = 0;
+        bool stop_ = false;
+
+        void Work();
+
+    public:
+
+        explicit ThreadPool(size_t threads = DefaultSize());
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool();
+
+        static size_t DefaultSize();
+
+        size_t Size() const {
+            return workers_.size();
+        }
+
+        void Submit(std::function<void()> task);
+
+        // Blocks until every submitted task has finished.
+        void Wait();
+
+        // Calls body(i) for every i in [0, count) on the pool and waits for all of them.
+        // The first exception thrown by body is rethrown here.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    };
+}
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "errors.h"
+#include "scanner.h"
+#include "stats.h"
+
+
+namespace omfl {
+
+    inline void DeleteSpaces(std::string_view& line) {
+        int i;
+        for (i = 0; i < line.size(); i++) {
+            if (line[i] != ' ') {
+                break;
+            }
+        }
+        line.remove_prefix(i);
+
+        for (i = line.size() - 1; i >= 0; i--) {
+            if (line[i] != ' ') {
+                break;
+            }
+        }
+        line.remove_suffix(line.size() - i - 1);
+    }
+
+    inline bool IsKeyChar(char c) {
+        return isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+    }
+
+    inline bool IsValueFloat(const std::string_view& value) {
+        size_t dots_count = 0;
+        bool digits = false;
+        for (size_t i = 0; i < value.size(); i++) {
+            if (value[i] == '.') {
+                dots_count++;
+                if (dots_count > 1 || i == 0 || i == value.size() - 1 || (i == 1 && (value[0] == '-' || value[0] == '+'))) {
+                    return false;
+                }
+            } else if ((value[i] == '-' || value[i] == '+') && i == 0) {
+                continue;
+            } else if (!isdigit(value[i])) {
+                return false;
+            } else if (!digits && isdigit(value[i])) {
+                digits = true;
+            }
+        }
+        if (dots_count == 0 || !digits) {
+            return false;
+        }
+        return true;
+    }
+
+    inline bool IsValueInt(const std::string_view& value) {
+        bool digits = false;
+        for (size_t i = 0; i < value.size(); i++) {
+            if ((value[i] == '-' || value[i] == '+') && i == 0) {
+                continue;
+            } else if (!isdigit(value[i])) {
+                return false;
+            } else if (!digits && isdigit(value[i])) {
+                digits = true;
+            }
+        }
+        if (!digits) {
+            return false;
+        }
+        return true;
+    }
+
+    inline bool IsValueString(const std::string_view& value) {
+        for (size_t i = 1; i < value.size() - 1; i++) {
+            if (value[i] == '\"') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // std::from_chars does not take a leading '+', the OMFL grammar does.
+    inline std::string_view DeletePlus(std::string_view value) {
+        if (!value.empty() && value.front() == '+') {
+            value.remove_prefix(1);
+        }
+        return value;
+    }
+
+    // Splits OMFL text into lines and reports what they hold to a Handler with these members:
+    //
+    //     void OnSection(std::string_view path);  // a header with a well-formed dotted path
+    //     bool OnKey(std::string_view key);       // start of a value, false skips the value
+    //     void OnInt(int64_t value);
+    //     void OnFloat(double value);
+    //     void OnBool(bool value);
+    //     void OnString(std::string_view value);
+    //     void OnArrayBegin();
+    //     void OnArrayEnd();
+    //     void OnError(ErrorKind kind, std::string_view span);
+    //     bool Stopped() const;
+    //
+    // OnError gets the malformed part of a line as a view into the text. Stopped is asked
+    // after every line, and true ends the parse there.
+    //
+    // Only the syntax of single lines is checked here: duplicate keys and sections that
+    // clash with values are for the handler to detect. A malformed value is reported once
+    // the tokenizer gets to the problem, so the events of its beginning come first.
+    template<typename Handler>
+    class Tokenizer {
+    private:
+
+        static constexpr size_t kBlockSize = 1 << 20;
+
+        Handler& handler_;
+
+        // Structural positions of the current block, kept between calls to reuse the storage.
+        std::unique_ptr<uint32_t[]> positions_;
+        size_t capacity_ = 0;
+
+        // Block being parsed and the structural characters of its current line.
+        const char* block_ = nullptr;
+        const uint32_t* structurals_ = nullptr;
+        size_t structurals_count_ = 0;
+
+#ifdef OMFL_ENABLE_STATS
+        PhaseClock clock_;
+#endif
+
+        // Instrumentation hooks, empty unless OMFL_ENABLE_STATS is defined.
+        void Count([[maybe_unused]] uint64_t ParseStats::* counter, [[maybe_unused]] uint64_t amount = 1) {
+            OMFL_STATS(if (clock_.stats() != nullptr) { clock_.stats()->*counter += amount; })
+        }
+
+        void Enter([[maybe_unused]] uint64_t ParseStats::* phase) {
+            OMFL_STATS(clock_.Switch(phase);)
+        }
+
+        bool EmitScalar(std::string_view value) {
+            if (value == "true" || value == "false") {
+                Enter(&ParseStats::build_ns);
+                handler_.OnBool(value == "true");
+            } else if (value.size() >= 2 && value.front() == '\"' && value.back() == '\"' && IsValueString(value)) {
+                Enter(&ParseStats::build_ns);
+                handler_.OnString(value.substr(1, value.size() - 2));
+            } else if (IsValueInt(value)) {
+                std::string_view digits = DeletePlus(value);
+                int64_t number;
+                if (std::from_chars(digits.data(), digits.data() + digits.size(), number).ec != std::errc()) {
+                    return false;
+                }
+                Enter(&ParseStats::build_ns);
+                handler_.OnInt(number);
+            } else if (IsValueFloat(value)) {
+                std::string_view digits = DeletePlus(value);
+                double number;
+                if (std::from_chars(digits.data(), digits.data() + digits.size(), number).ec != std::errc()) {
+                    return false;
+                }
+                Enter(&ParseStats::build_ns);
+                handler_.OnFloat(number);
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        // Reports a bool, string, int or float, or returns false if value is none of them.
+        bool ParseScalar(std::string_view value) {
+            Enter(&ParseStats::convert_ns);
+            bool result = EmitScalar(value);
+            Enter(&ParseStats::tokenize_ns);
+            return result;
+        }
+
+        // Reports the start or the end of an array.
+        void EmitArray(bool begin) {
+            Enter(&ParseStats::build_ns);
+            if (begin) {
+                handler_.OnArrayBegin();
+            } else {
+                handler_.OnArrayEnd();
+            }
+            Enter(&ParseStats::tokenize_ns);
+        }
+
+        // Reports the scalar between two structural characters of an array.
+        // Blank elements are skipped; anything else right after a nested array is an error.
+        bool AddElement(std::string_view element, bool after_array) {
+            DeleteSpaces(element);
+            if (element.empty()) {
+                return true;
+            }
+            if (after_array) {
+                return false;
+            }
+            Count(&ParseStats::array_elements);
+            return ParseScalar(element);
+        }
+
+        // Returns false if the value is malformed.
+        bool ParseValue(std::string_view value) {
+            if (value.front() != '[') {
+                return ParseScalar(value);
+            }
+
+            // Arrays are parsed in one pass over the structural characters of the value:
+            // '[' opens a nested array, ',' and ']' end the element that started after the
+            // previous structural character.
+            size_t depth = 1;
+            EmitArray(true);
+
+            size_t value_begin = value.data() - block_;
+            size_t value_end = value_begin + value.size();
+            size_t element_begin = value_begin + 1;
+            bool in_string = false;
+            bool after_array = false;
+
+            for (size_t i = 0; i < structurals_count_; i++) {
+                size_t position = structurals_[i];
+                if (position <= value_begin || position >= value_end) {
+                    continue;
+                }
+                char c = block_[position];
+                if (in_string) {
+                    in_string = c != '\"';
+                    continue;
+                }
+                if (depth == 0) {
+                    return false;
+                }
+
+                std::string_view element(block_ + element_begin, position - element_begin);
+                if (c == '\"') {
+                    in_string = true;
+                } else if (c == '[') {
+                    DeleteSpaces(element);
+                    if (!element.empty() || after_array) {
+                        return false;
+                    }
+                    depth++;
+                    Count(&ParseStats::array_elements);
+                    EmitArray(true);
+                    element_begin = position + 1;
+                } else if (c == ',' || c == ']') {
+                    if (!AddElement(element, after_array)) {
+                        return false;
+                    }
+                    after_array = c == ']';
+                    if (after_array) {
+                        depth--;
+                        EmitArray(false);
+                    }
+                    element_begin = position + 1;
+                }
+            }
+
+            return !in_string && depth == 0 && element_begin == value_end;
+        }
+
+        void ParseSection(std::string_view line) {
+            if (line.size() == 2 || line[line.size() - 2] == '.' || line[1] == '.') {
+                handler_.OnError(ErrorKind::kInvalidSection, line);
+                return;
+            }
+            for (size_t i = 1; i < line.size() - 1; i++) {
+                if (line[i] == '.' ? line[i - 1] == '.' : !IsKeyChar(line[i])) {
+                    handler_.OnError(ErrorKind::kInvalidSection, line);
+                    return;
+                }
+            }
+            Count(&ParseStats::sections);
+            Enter(&ParseStats::build_ns);
+            handler_.OnSection(line.substr(1, line.size() - 2));
+            Enter(&ParseStats::tokenize_ns);
+        }
+
+        // `equal` is the position of the '=' separating key and value.
+        void ParseVariable(std::string_view line, size_t equal) {
+            std::string_view key = line.substr(0, equal);
+            std::string_view value = line.substr(equal + 1);
+            DeleteSpaces(key);
+            DeleteSpaces(value);
+
+            if (key.empty() || !std::all_of(key.begin(), key.end(), IsKeyChar)) {
+                handler_.OnError(ErrorKind::kInvalidKey, key.empty() ? line : key);
+                return;
+            }
+            if (value.empty()) {
+                handler_.OnError(ErrorKind::kMissingValue, line);
+                return;
+            }
+            Count(&ParseStats::keys);
+            Enter(&ParseStats::build_ns);
+            bool parse_value = handler_.OnKey(key);
+            Enter(&ParseStats::tokenize_ns);
+            if (parse_value && !ParseValue(value)) {
+                handler_.OnError(ErrorKind::kInvalidValue, value);
+            }
+        }
+
+        // structurals holds the positions of the structural characters of this line,
+        // relative to the block that starts `offset` bytes before it.
+        void ParseLine(std::string_view line, const uint32_t* structurals, size_t count, size_t offset) {
+            structurals_ = structurals;
+            structurals_count_ = count;
+            size_t end = line.size();
+            size_t equal = std::string_view::npos;
+            bool in_string = false;
+            for (size_t i = 0; i < count; i++) {
+                size_t position = structurals[i] - offset;
+                if (line[position] == '\"') {
+                    in_string = !in_string;
+                } else if (in_string) {
+                    continue;
+                } else if (line[position] == '#') {
+                    end = position;
+                    break;
+                } else if (line[position] == '=' && equal == std::string_view::npos) {
+                    equal = position;
+                }
+            }
+
+            line = line.substr(0, end);
+            const char* start = line.data();
+            DeleteSpaces(line);
+            if (line.empty()) {
+                return;
+            }
+            if (line.front() == '[' && line.back() == ']') {
+                ParseSection(line);
+            } else if (equal >= end) {
+                handler_.OnError(ErrorKind::kInvalidLine, line);
+            } else {
+                ParseVariable(line, equal - (line.data() - start));
+            }
+        }
+
+        // Splits a block into lines along the '\n' entries of its structural index.
+        void ParseBlock(std::string_view block, const uint32_t* structurals, size_t count) {
+            block_ = block.data();
+            size_t line_begin = 0;
+            size_t next = 0;
+            while (true) {
+                size_t first = next;
+                while (next < count && block[structurals[next]] != '\n') {
+                    next++;
+                }
+                size_t line_end = next < count ? structurals[next] : block.size();
+                // The empty rest after a final newline is no line.
+                Count(&ParseStats::lines, next < count || line_end > line_begin ? 1 : 0);
+                ParseLine(block.substr(line_begin, line_end - line_begin), structurals + first, next - first, line_begin);
+                if (next == count || handler_.Stopped()) {
+                    return;
+                }
+                line_begin = line_end + 1;
+                next++;
+            }
+        }
+
+    public:
+
+        explicit Tokenizer(Handler& handler) : handler_(handler) {
+        }
+
+#ifdef OMFL_ENABLE_STATS
+        // Adds the counters and times of every following parse to stats.
+        void Observe(ParseStats& stats) {
+            clock_.Attach(stats);
+        }
+#endif
+
+        // Text after the last newline is taken as a complete last line.
+        void ParseText(std::string_view text) {
+            Count(&ParseStats::bytes, text.size());
+            Enter(&ParseStats::tokenize_ns);
+            // The structural index is built one block at a time so its size stays bounded.
+            // Blocks end right after a newline, which keeps every line inside a single block.
+            while (true) {
+                size_t block_size = text.size();
+                if (block_size > kBlockSize) {
+                    size_t newline = text.rfind('\n', kBlockSize - 1);
+                    if (newline == std::string_view::npos) {
+                        newline = text.find('\n', kBlockSize);
+                    }
+                    block_size = newline == std::string_view::npos ? text.size() : newline + 1;
+                }
+                std::string_view block = text.substr(0, block_size);
+                if (capacity_ < block.size()) {
+                    capacity_ = std::max(block.size(), std::min(text.size(), kBlockSize));
+                    positions_.reset(new uint32_t[capacity_]);
+                }
+                ParseBlock(block, positions_.get(), FindStructurals(block, positions_.get()));
+
+                text.remove_prefix(block_size);
+                if (text.empty() || handler_.Stopped()) {
+                    break;
+                }
+            }
+            Enter(nullptr);
+        }
+
+    };
+
+    // Tokenizes the header lines of a text and nothing else, for passes that only need to
+    // know where its sections begin. Reports every header line to a HeaderHandler with
+    // these members:
+    //
+    //     void OnHeader(std::string_view path, size_t begin, size_t end);
+    //     void OnHeaderError(ErrorKind kind, std::string_view span, size_t begin, size_t end);
+    //     bool Stopped() const;
+    //
+    // begin and end are the offsets of the line in the text, without its '\n'. Stopped is
+    // asked after every header line, and true ends the scan there.
+    template<typename HeaderHandler>
+    class HeaderScanner {
+    private:
+
+        HeaderHandler& handler_;
+        Tokenizer<HeaderScanner> tokenizer_;
+        // Header line being tokenized.
+        size_t line_begin_ = 0;
+        size_t line_end_ = 0;
+
+        friend class Tokenizer<HeaderScanner>;
+
+        void OnSection(std::string_view path) {
+            handler_.OnHeader(path, line_begin_, line_end_);
+        }
+
+        bool OnKey(std::string_view) {
+            return false;
+        }
+
+        void OnInt(int64_t) {
+        }
+
+        void OnFloat(double) {
+        }
+
+        void OnBool(bool) {
+        }
+
+        void OnString(std::string_view) {
+        }
+
+        void OnArrayBegin() {
+        }
+
+        void OnArrayEnd() {
+        }
+
+        void OnError(ErrorKind kind, std::string_view span) {
+            handler_.OnHeaderError(kind, span, line_begin_, line_end_);
+        }
+
+        bool Stopped() const {
+            return handler_.Stopped();
+        }
+
+    public:
+
+        explicit HeaderScanner(HeaderHandler& handler) : handler_(handler), tokenizer_(*this) {
+        }
+
+        void Scan(std::string_view text) {
+            ForEachHeaderLine(text, 0, [this, text](size_t begin, size_t end) {
+                line_begin_ = begin;
+                line_end_ = end;
+                tokenizer_.ParseText(text.substr(begin, end - begin));
+                return !handler_.Stopped();
+            });
+        }
+
+    };
+}
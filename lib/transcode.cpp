@@ -0,0 +1,294 @@
+#include "transcode.h"
+
+#include "key_index.h"
+#include "mapped_file.h"
+#include "scanner.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace omfl;
+
+namespace {
+
+    constexpr uint32_t kRun = UINT32_MAX;
+
+    // Set of the keys of one section. Clear keeps the storage, so one set per nesting
+    // level serves every section written at that level.
+    class KeySet {
+    private:
+
+        std::vector<std::string_view> slots_;
+        size_t size_ = 0;
+
+        bool Place(std::string_view key) {
+            size_t mask = slots_.size() - 1;
+            for (size_t i = HashKey(key) & mask;; i = (i + 1) & mask) {
+                if (slots_[i].data() == nullptr) {
+                    slots_[i] = key;
+                    return true;
+                }
+                if (slots_[i] == key) {
+                    return false;
+                }
+            }
+        }
+
+    public:
+
+        // Returns false if the key is already there.
+        bool Insert(std::string_view key) {
+            if (2 * (size_ + 1) > slots_.size()) {
+                std::vector<std::string_view> old(std::max<size_t>(16, 2 * slots_.size()));
+                old.swap(slots_);
+                for (std::string_view existing : old) {
+                    if (existing.data() != nullptr) {
+                        Place(existing);
+                    }
+                }
+            }
+            if (!Place(key)) {
+                return false;
+            }
+            size_++;
+            return true;
+        }
+
+        void Clear() {
+            if (size_ != 0) {
+                std::fill(slots_.begin(), slots_.end(), std::string_view());
+                size_ = 0;
+            }
+        }
+
+    };
+
+    // A member of a section in document order: either a range of value lines of the
+    // text or a child section.
+    struct OutlineItem {
+        uint32_t child = kRun;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    struct OutlineSection {
+        std::string_view name;
+        std::vector<OutlineItem> items;
+        std::unordered_map<std::string_view, uint32_t> children;
+    };
+
+    // First pass: records where each header line sends the lines after it.
+    class OutlineBuilder {
+    private:
+
+        std::string_view text_;
+        std::vector<OutlineSection> sections_;
+        uint32_t current_ = 0;
+        size_t run_begin_ = 0;
+        bool valid_ = true;
+
+        // Ends the run of the current section at `end`.
+        void CloseRun(size_t end) {
+            if (end > run_begin_) {
+                OutlineItem run;
+                run.begin = run_begin_;
+                run.end = end;
+                sections_[current_].items.push_back(run);
+            }
+        }
+
+        uint32_t OpenSection(uint32_t parent, std::string_view name) {
+            auto found = sections_[parent].children.find(name);
+            if (found != sections_[parent].children.end()) {
+                return found->second;
+            }
+            auto child = static_cast<uint32_t>(sections_.size());
+            sections_[parent].children.emplace(name, child);
+            OutlineItem item;
+            item.child = child;
+            sections_[parent].items.push_back(item);
+            sections_.emplace_back();
+            sections_.back().name = name;
+            return child;
+        }
+
+    public:
+
+        explicit OutlineBuilder(std::string_view text) : text_(text), sections_(1) {
+        }
+
+        void OnHeader(std::string_view path, size_t begin, size_t end) {
+            CloseRun(begin);
+
+            uint32_t section = 0;
+            while (true) {
+                size_t dot = path.find('.');
+                section = OpenSection(section, path.substr(0, dot));
+                if (dot == std::string_view::npos) {
+                    break;
+                }
+                path.remove_prefix(dot + 1);
+            }
+            current_ = section;
+            run_begin_ = end + 1;
+        }
+
+        void OnHeaderError(ErrorKind, std::string_view, size_t, size_t) {
+            valid_ = false;
+        }
+
+        bool Stopped() const {
+            return !valid_;
+        }
+
+        // Returns false if a header line is malformed.
+        bool Build() {
+            HeaderScanner<OutlineBuilder>(*this).Scan(text_);
+            CloseRun(text_.size());
+            return valid_;
+        }
+
+        std::vector<OutlineSection>& sections() {
+            return sections_;
+        }
+
+    };
+
+    // Second pass: writes the sections of the outline in order and checks the keys of
+    // each one for duplicates and clashes with child sections.
+    class OutlineWriter {
+    private:
+
+        std::string_view text_;
+        std::vector<OutlineSection>& sections_;
+        Writer& writer_;
+        Tokenizer<OutlineWriter> tokenizer_;
+
+        // Keys of the sections being written, one set per nesting level.
+        std::vector<KeySet> keys_;
+        size_t level_ = 0;
+        std::string_view pending_key_;
+        size_t depth_ = 0;
+        bool valid_ = true;
+
+        friend class Tokenizer<OutlineWriter>;
+
+        std::string_view Key() const {
+            return depth_ == 0 ? pending_key_ : std::string_view();
+        }
+
+        void OnSection(std::string_view) {
+        }
+
+        bool OnKey(std::string_view key) {
+            if (!keys_[level_ - 1].Insert(key)) {
+                valid_ = false;
+                return false;
+            }
+            pending_key_ = key;
+            depth_ = 0;
+            return true;
+        }
+
+        void OnInt(int64_t value) {
+            writer_.Int(Key(), value);
+        }
+
+        void OnFloat(double value) {
+            writer_.Float(Key(), value);
+        }
+
+        void OnBool(bool value) {
+            writer_.Bool(Key(), value);
+        }
+
+        void OnString(std::string_view value) {
+            writer_.String(Key(), value);
+        }
+
+        void OnArrayBegin() {
+            writer_.BeginArray(Key());
+            depth_++;
+        }
+
+        void OnArrayEnd() {
+            depth_--;
+            writer_.EndArray(Key());
+        }
+
+        void OnError(ErrorKind, std::string_view) {
+            valid_ = false;
+        }
+
+        bool Stopped() const {
+            return !valid_;
+        }
+
+        void WriteMembers(const OutlineSection& section) {
+            if (level_ == keys_.size()) {
+                keys_.emplace_back();
+            }
+            keys_[level_++].Clear();
+            for (const OutlineItem& item : section.items) {
+                if (!valid_) {
+                    return;
+                }
+                if (item.child == kRun) {
+                    tokenizer_.ParseText(text_.substr(item.begin, item.end - item.begin));
+                    continue;
+                }
+                const OutlineSection& child = sections_[item.child];
+                if (!keys_[level_ - 1].Insert(child.name)) {
+                    valid_ = false;
+                    return;
+                }
+                writer_.BeginSection(child.name);
+                WriteMembers(child);
+                writer_.EndSection(child.name);
+            }
+            level_--;
+        }
+
+    public:
+
+        OutlineWriter(std::string_view text, std::vector<OutlineSection>& sections, Writer& writer)
+            : text_(text), sections_(sections), writer_(writer), tokenizer_(*this) {
+        }
+
+        bool Write() {
+            writer_.BeginDocument();
+            WriteMembers(sections_.front());
+            writer_.EndDocument();
+            return valid_;
+        }
+
+    };
+
+    bool Transcode(std::string_view text, Writer& writer) {
+        OutlineBuilder outline(text);
+        if (!outline.Build()) {
+            return false;
+        }
+        // Child lookups are only needed while the outline is built.
+        for (OutlineSection& section : outline.sections()) {
+            std::unordered_map<std::string_view, uint32_t>().swap(section.children);
+        }
+        return OutlineWriter(text, outline.sections(), writer).Write();
+    }
+}
+
+bool omfl::transcode(const std::string& code, Writer& writer) {
+    return Transcode(code, writer);
+}
+
+bool omfl::transcode(const std::filesystem::path& path, Writer& writer) {
+    MappedFile file(path);
+    if (!file.valid()) {
+        return false;
+    }
+    return Transcode(file.bytes(), writer);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "writer.h"
+
+
+namespace omfl {
+
+    // Converts OMFL straight into writer events, with the same output a parsed document
+    // would give, without building a tree. A first pass over the text records the outline
+    // of the sections: their names and the ranges of lines each header opens. A second
+    // pass walks the outline and tokenizes every range once while writing it. Memory is
+    // proportional to the number of sections and the keys of the sections being written,
+    // not to the size of the text.
+    //
+    // Returns false for an invalid document. Errors found while writing leave incomplete
+    // output behind, which is then to be discarded.
+    bool transcode(const std::string& code, Writer& writer);
+
+    // Reads the file through a memory mapping.
+    bool transcode(const std::filesystem::path& path, Writer& writer);
+}
@@ -0,0 +1,558 @@
+#include "writer.h"
+
+#include <cstring>
+
+using namespace omfl;
+
+namespace {
+
+    // Writes an unsigned integer in big-endian byte order, as MessagePack stores every
+    // number, and returns the position after it.
+    template<typename T>
+    char* PutBigEndian(char* out, T value) {
+        for (size_t i = sizeof(T); i-- > 0;) {
+            *out++ = static_cast<char>(value >> (8 * i));
+        }
+        return out;
+    }
+
+    // Appends a type byte followed by value.
+    template<typename T>
+    void PutTagged(std::string& out, uint8_t type, T value) {
+        char bytes[1 + sizeof(T)];
+        bytes[0] = static_cast<char>(type);
+        PutBigEndian(bytes + 1, value);
+        out.append(bytes, sizeof(bytes));
+    }
+
+    void PutBool(OutputBuffer& out, bool value) {
+        out.Put(value ? std::string_view("true") : std::string_view("false"));
+    }
+
+    // Copies runs of plain characters in one go and escapes the rest.
+    template<typename Escape>
+    void PutEscaped(OutputBuffer& out, std::string_view text, Escape escape) {
+        size_t plain = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            std::string_view replacement = escape(text[i]);
+            if (!replacement.empty()) {
+                out.Put(text.substr(plain, i - plain));
+                out.Put(replacement);
+                plain = i + 1;
+            }
+        }
+        out.Put(text.substr(plain));
+    }
+
+    std::string_view EscapeJson(char c) {
+        static const char kControl[][7] = {
+            "\\u0000", "\\u0001", "\\u0002", "\\u0003", "\\u0004", "\\u0005", "\\u0006", "\\u0007",
+            "\\b", "\\t", "\\n", "\\u000b", "\\f", "\\r", "\\u000e", "\\u000f",
+            "\\u0010", "\\u0011", "\\u0012", "\\u0013", "\\u0014", "\\u0015", "\\u0016", "\\u0017",
+            "\\u0018", "\\u0019", "\\u001a", "\\u001b", "\\u001c", "\\u001d", "\\u001e", "\\u001f",
+        };
+        if (c == '\\') {
+            return "\\\\";
+        }
+        if (c == '"') {
+            return "\\\"";
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            return kControl[static_cast<unsigned char>(c)];
+        }
+        return {};
+    }
+
+    std::string_view EscapeXml(char c) {
+        switch (c) {
+            case '<':
+                return "&lt;";
+            case '>':
+                return "&gt;";
+            case '&':
+                return "&amp;";
+            default:
+                return {};
+        }
+    }
+
+    void WriteNode(const Node& node, uintptr_t base, Writer& writer) {
+        std::string_view key = node.Key(base);
+        switch (node.type) {
+            case NodeType::kInt:
+                writer.Int(key, node.int_value);
+                break;
+            case NodeType::kFloat:
+                writer.Float(key, node.float_value);
+                break;
+            case NodeType::kBool:
+                writer.Bool(key, node.bool_value);
+                break;
+            case NodeType::kString:
+                writer.String(key, node.String(base));
+                break;
+            case NodeType::kSection: {
+                writer.BeginSection(key);
+                const Node* members = node.Body(base)->Members(base);
+                for (size_t i = 0; i < node.size; i++) {
+                    WriteNode(members[i], base, writer);
+                }
+                writer.EndSection(key);
+                break;
+            }
+            case NodeType::kArray: {
+                writer.BeginArray(key);
+                if (node.packed == NodeType::kInt) {
+                    for (size_t i = 0; i < node.size; i++) {
+                        writer.Int({}, node.Ints(base)[i]);
+                    }
+                } else if (node.packed == NodeType::kFloat) {
+                    for (size_t i = 0; i < node.size; i++) {
+                        writer.Float({}, node.Floats(base)[i]);
+                    }
+                } else if (node.packed == NodeType::kBool) {
+                    for (size_t i = 0; i < node.size; i++) {
+                        writer.Bool({}, node.Bools(base)[i]);
+                    }
+                } else {
+                    const Node* elements = node.Elements(base);
+                    for (size_t i = 0; i < node.size; i++) {
+                        WriteNode(elements[i], base, writer);
+                    }
+                }
+                writer.EndArray(key);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+void omfl::WriteDocument(const Node& root, uintptr_t base, Writer& writer) {
+    writer.BeginDocument();
+    if (root.type == NodeType::kSection) {
+        const Node* members = root.Body(base)->Members(base);
+        for (size_t i = 0; i < root.size; i++) {
+            WriteNode(members[i], base, writer);
+        }
+    }
+    writer.EndDocument();
+}
+
+void JsonWriter::Item(std::string_view key) {
+    out_.Put(first_ ? std::string_view("\n") : std::string_view(",\n"));
+    first_ = false;
+    out_.PutRepeated(' ', 2 * depth_);
+    if (!key.empty()) {
+        out_.Put('"');
+        out_.Put(key);
+        out_.Put("\": ");
+    }
+}
+
+void JsonWriter::Close(char bracket) {
+    depth_--;
+    out_.Put('\n');
+    out_.PutRepeated(' ', 2 * depth_);
+    out_.Put(bracket);
+    first_ = false;
+}
+
+void JsonWriter::BeginDocument() {
+    out_.Put('{');
+    depth_ = 1;
+    first_ = true;
+}
+
+void JsonWriter::EndDocument() {
+    Close('}');
+    out_.Flush();
+}
+
+void JsonWriter::BeginSection(std::string_view key) {
+    Item(key);
+    out_.Put('{');
+    depth_++;
+    first_ = true;
+}
+
+void JsonWriter::EndSection(std::string_view) {
+    Close('}');
+}
+
+void JsonWriter::BeginArray(std::string_view key) {
+    Item(key);
+    out_.Put('[');
+    depth_++;
+    first_ = true;
+}
+
+void JsonWriter::EndArray(std::string_view) {
+    Close(']');
+}
+
+void JsonWriter::Int(std::string_view key, int64_t value) {
+    Item(key);
+    out_.PutInt(value);
+}
+
+void JsonWriter::Float(std::string_view key, double value) {
+    Item(key);
+    out_.PutDouble(value);
+}
+
+void JsonWriter::Bool(std::string_view key, bool value) {
+    Item(key);
+    PutBool(out_, value);
+}
+
+void JsonWriter::String(std::string_view key, std::string_view value) {
+    Item(key);
+    out_.Put('"');
+    PutEscaped(out_, value, EscapeJson);
+    out_.Put('"');
+}
+
+void YamlWriter::Item(std::string_view key) {
+    out_.PutRepeated(' ', margins_);
+    if (key.empty()) {
+        out_.Put("- ");
+    } else {
+        out_.Put(key);
+        out_.Put(": ");
+    }
+}
+
+void YamlWriter::BeginDocument() {
+    out_.Put("---\n");
+    margins_ = 0;
+}
+
+void YamlWriter::EndDocument() {
+    out_.Put("...");
+    out_.Flush();
+}
+
+void YamlWriter::BeginSection(std::string_view key) {
+    Item(key);
+    out_.Put('\n');
+    margins_++;
+}
+
+void YamlWriter::EndSection(std::string_view) {
+    margins_--;
+}
+
+void YamlWriter::BeginArray(std::string_view key) {
+    Item(key);
+    out_.Put('\n');
+    margins_++;
+}
+
+void YamlWriter::EndArray(std::string_view) {
+    margins_--;
+}
+
+void YamlWriter::Int(std::string_view key, int64_t value) {
+    Item(key);
+    out_.PutInt(value);
+    out_.Put('\n');
+}
+
+void YamlWriter::Float(std::string_view key, double value) {
+    Item(key);
+    out_.PutDouble(value);
+    out_.Put('\n');
+}
+
+void YamlWriter::Bool(std::string_view key, bool value) {
+    Item(key);
+    PutBool(out_, value);
+    out_.Put('\n');
+}
+
+void YamlWriter::String(std::string_view key, std::string_view value) {
+    Item(key);
+    out_.Put(value);
+    out_.Put('\n');
+}
+
+void XmlWriter::BeginDocument() {
+    out_.Put("<root>\n");
+    arrays_ = 0;
+}
+
+void XmlWriter::EndDocument() {
+    out_.Put("</root>\n");
+    out_.Flush();
+}
+
+void XmlWriter::BeginSection(std::string_view key) {
+    Open(key);
+    out_.Put('\n');
+}
+
+void XmlWriter::EndSection(std::string_view key) {
+    Close(key);
+}
+
+void XmlWriter::BeginArray(std::string_view) {
+    arrays_++;
+}
+
+void XmlWriter::EndArray(std::string_view) {
+    arrays_--;
+}
+
+void XmlWriter::Open(std::string_view key) {
+    out_.Put('<');
+    out_.Put(key);
+    out_.Put('>');
+}
+
+void XmlWriter::Close(std::string_view key) {
+    out_.Put("</");
+    out_.Put(key);
+    out_.Put(">\n");
+}
+
+void XmlWriter::Int(std::string_view key, int64_t value) {
+    if (arrays_ == 0) {
+        Open(key);
+        out_.PutInt(value);
+        Close(key);
+    }
+}
+
+void XmlWriter::Float(std::string_view key, double value) {
+    if (arrays_ == 0) {
+        Open(key);
+        out_.PutDouble(value);
+        Close(key);
+    }
+}
+
+void XmlWriter::Bool(std::string_view key, bool value) {
+    if (arrays_ == 0) {
+        Open(key);
+        PutBool(out_, value);
+        Close(key);
+    }
+}
+
+void XmlWriter::String(std::string_view key, std::string_view value) {
+    if (arrays_ == 0) {
+        Open(key);
+        PutEscaped(out_, value, EscapeXml);
+        Close(key);
+    }
+}
+
+void MsgPackWriter::Item(std::string_view key) {
+    open_.back().second++;
+    if (!key.empty()) {
+        PutString(key);
+    }
+}
+
+void MsgPackWriter::PutString(std::string_view value) {
+    if (value.size() < 32) {
+        data_.push_back(static_cast<char>(0xa0 | value.size()));
+    } else if (value.size() <= UINT8_MAX) {
+        PutTagged(data_, 0xd9, static_cast<uint8_t>(value.size()));
+    } else if (value.size() <= UINT16_MAX) {
+        PutTagged(data_, 0xda, static_cast<uint16_t>(value.size()));
+    } else {
+        PutTagged(data_, 0xdb, static_cast<uint32_t>(value.size()));
+    }
+    data_.append(value);
+}
+
+void MsgPackWriter::Open(std::string_view key) {
+    Item(key);
+    open_.emplace_back(data_.size(), 0);
+    data_.append(5, '\0');
+}
+
+void MsgPackWriter::Close(uint8_t fixed, uint8_t code16, uint8_t code32) {
+    auto [begin, count] = open_.back();
+    open_.pop_back();
+
+    char header[5];
+    char* end = header + 1;
+    if (count < 16) {
+        header[0] = static_cast<char>(fixed | count);
+    } else if (count <= UINT16_MAX) {
+        header[0] = static_cast<char>(code16);
+        end = PutBigEndian(end, static_cast<uint16_t>(count));
+    } else {
+        header[0] = static_cast<char>(code32);
+        end = PutBigEndian(end, count);
+    }
+    // The body moves back over the bytes the header does not need.
+    auto size = static_cast<size_t>(end - header);
+    data_.erase(begin + size, sizeof(header) - size);
+    std::memcpy(data_.data() + begin, header, size);
+}
+
+void MsgPackWriter::BeginDocument() {
+    data_.clear();
+    open_.assign(1, {0, 0});
+    data_.append(5, '\0');
+}
+
+void MsgPackWriter::EndDocument() {
+    Close(0x80, 0xde, 0xdf);
+    sink_.Write(data_.data(), data_.size());
+    std::string().swap(data_);
+}
+
+void MsgPackWriter::BeginSection(std::string_view key) {
+    Open(key);
+}
+
+void MsgPackWriter::EndSection(std::string_view) {
+    Close(0x80, 0xde, 0xdf);
+}
+
+void MsgPackWriter::BeginArray(std::string_view key) {
+    Open(key);
+}
+
+void MsgPackWriter::EndArray(std::string_view) {
+    Close(0x90, 0xdc, 0xdd);
+}
+
+void MsgPackWriter::Int(std::string_view key, int64_t value) {
+    Item(key);
+    if (value >= -32 && value <= INT8_MAX) {
+        data_.push_back(static_cast<char>(value));
+    } else if (value >= 0) {
+        if (value <= UINT8_MAX) {
+            PutTagged(data_, 0xcc, static_cast<uint8_t>(value));
+        } else if (value <= UINT16_MAX) {
+            PutTagged(data_, 0xcd, static_cast<uint16_t>(value));
+        } else if (value <= UINT32_MAX) {
+            PutTagged(data_, 0xce, static_cast<uint32_t>(value));
+        } else {
+            PutTagged(data_, 0xcf, static_cast<uint64_t>(value));
+        }
+    } else if (value >= INT8_MIN) {
+        PutTagged(data_, 0xd0, static_cast<uint8_t>(value));
+    } else if (value >= INT16_MIN) {
+        PutTagged(data_, 0xd1, static_cast<uint16_t>(value));
+    } else if (value >= INT32_MIN) {
+        PutTagged(data_, 0xd2, static_cast<uint32_t>(value));
+    } else {
+        PutTagged(data_, 0xd3, static_cast<uint64_t>(value));
+    }
+}
+
+void MsgPackWriter::Float(std::string_view key, double value) {
+    Item(key);
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    PutTagged(data_, 0xcb, bits);
+}
+
+void MsgPackWriter::Bool(std::string_view key, bool value) {
+    Item(key);
+    data_.push_back(static_cast<char>(value ? 0xc3 : 0xc2));
+}
+
+void MsgPackWriter::String(std::string_view key, std::string_view value) {
+    Item(key);
+    PutString(value);
+}
+
+void FanOutWriter::BeginDocument() {
+    for (Writer* writer : writers_) {
+        writer->BeginDocument();
+    }
+}
+
+void FanOutWriter::EndDocument() {
+    for (Writer* writer : writers_) {
+        writer->EndDocument();
+    }
+}
+
+void FanOutWriter::BeginSection(std::string_view key) {
+    for (Writer* writer : writers_) {
+        writer->BeginSection(key);
+    }
+}
+
+void FanOutWriter::EndSection(std::string_view key) {
+    for (Writer* writer : writers_) {
+        writer->EndSection(key);
+    }
+}
+
+void FanOutWriter::BeginArray(std::string_view key) {
+    for (Writer* writer : writers_) {
+        writer->BeginArray(key);
+    }
+}
+
+void FanOutWriter::EndArray(std::string_view key) {
+    for (Writer* writer : writers_) {
+        writer->EndArray(key);
+    }
+}
+
+void FanOutWriter::Int(std::string_view key, int64_t value) {
+    for (Writer* writer : writers_) {
+        writer->Int(key, value);
+    }
+}
+
+void FanOutWriter::Float(std::string_view key, double value) {
+    for (Writer* writer : writers_) {
+        writer->Float(key, value);
+    }
+}
+
+void FanOutWriter::Bool(std::string_view key, bool value) {
+    for (Writer* writer : writers_) {
+        writer->Bool(key, value);
+    }
+}
+
+void FanOutWriter::String(std::string_view key, std::string_view value) {
+    for (Writer* writer : writers_) {
+        writer->String(key, value);
+    }
+}
+
+std::optional<Format> omfl::FormatOf(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    if (extension == ".json") {
+        return Format::kJson;
+    }
+    if (extension == ".yaml" || extension == ".yml") {
+        return Format::kYaml;
+    }
+    if (extension == ".xml") {
+        return Format::kXml;
+    }
+    if (extension == ".msgpack") {
+        return Format::kMsgPack;
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<Writer> omfl::MakeWriter(Format format, OutputSink& sink) {
+    switch (format) {
+        case Format::kJson:
+            return std::make_unique<JsonWriter>(sink);
+        case Format::kYaml:
+            return std::make_unique<YamlWriter>(sink);
+        case Format::kXml:
+            return std::make_unique<XmlWriter>(sink);
+        case Format::kMsgPack:
+            return std::make_unique<MsgPackWriter>(sink);
+    }
+    return nullptr;
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "node.h"
+#include "output.h"
+
+
+namespace omfl {
+
+    // Receives a document as a sequence of events, in document order. Keys are empty
+    // for array elements.
+    class Writer {
+    public:
+
+        virtual ~Writer() = default;
+
+        virtual void BeginDocument() = 0;
+
+        virtual void EndDocument() = 0;
+
+        virtual void BeginSection(std::string_view key) = 0;
+
+        virtual void EndSection(std::string_view key) = 0;
+
+        virtual void BeginArray(std::string_view key) = 0;
+
+        virtual void EndArray(std::string_view key) = 0;
+
+        virtual void Int(std::string_view key, int64_t value) = 0;
+
+        virtual void Float(std::string_view key, double value) = 0;
+
+        virtual void Bool(std::string_view key, bool value) = 0;
+
+        virtual void String(std::string_view key, std::string_view value) = 0;
+
+    };
+
+    class JsonWriter : public Writer {
+    private:
+
+        OutputBuffer out_;
+        size_t depth_ = 0;
+        bool first_ = true;
+
+        void Item(std::string_view key);
+
+        void Close(char bracket);
+
+    public:
+
+        explicit JsonWriter(OutputSink& sink) : out_(sink) {
+        }
+
+        void BeginDocument() override;
+
+        void EndDocument() override;
+
+        void BeginSection(std::string_view key) override;
+
+        void EndSection(std::string_view key) override;
+
+        void BeginArray(std::string_view key) override;
+
+        void EndArray(std::string_view key) override;
+
+        void Int(std::string_view key, int64_t value) override;
+
+        void Float(std::string_view key, double value) override;
+
+        void Bool(std::string_view key, bool value) override;
+
+        void String(std::string_view key, std::string_view value) override;
+
+    };
+
+    class YamlWriter : public Writer {
+    private:
+
+        OutputBuffer out_;
+        size_t margins_ = 0;
+
+        void Item(std::string_view key);
+
+    public:
+
+        explicit YamlWriter(OutputSink& sink) : out_(sink) {
+        }
+
+        void BeginDocument() override;
+
+        void EndDocument() override;
+
+        void BeginSection(std::string_view key) override;
+
+        void EndSection(std::string_view key) override;
+
+        void BeginArray(std::string_view key) override;
+
+        void EndArray(std::string_view key) override;
+
+        void Int(std::string_view key, int64_t value) override;
+
+        void Float(std::string_view key, double value) override;
+
+        void Bool(std::string_view key, bool value) override;
+
+        void String(std::string_view key, std::string_view value) override;
+
+    };
+
+    // XML has no representation for arrays here, so they are left out.
+    class XmlWriter : public Writer {
+    private:
+
+        OutputBuffer out_;
+        size_t arrays_ = 0;
+
+        void Open(std::string_view key);
+
+        void Close(std::string_view key);
+
+    public:
+
+        explicit XmlWriter(OutputSink& sink) : out_(sink) {
+        }
+
+        void BeginDocument() override;
+
+        void EndDocument() override;
+
+        void BeginSection(std::string_view key) override;
+
+        void EndSection(std::string_view key) override;
+
+        void BeginArray(std::string_view key) override;
+
+        void EndArray(std::string_view key) override;
+
+        void Int(std::string_view key, int64_t value) override;
+
+        void Float(std::string_view key, double value) override;
+
+        void Bool(std::string_view key, bool value) override;
+
+        void String(std::string_view key, std::string_view value) override;
+
+    };
+
+    // MessagePack: sections are maps, arrays are arrays, keys and strings are str,
+    // integers take their shortest encoding and floats are float64. Containers are
+    // prefixed with their length, which is only known at their end, so the document is
+    // assembled in memory and handed to the sink in one piece by EndDocument.
+    class MsgPackWriter : public Writer {
+    private:
+
+        OutputSink& sink_;
+        std::string data_;
+        // Where the header of every open container starts and how many items it has so far.
+        std::vector<std::pair<size_t, uint32_t>> open_;
+
+        void Item(std::string_view key);
+
+        void PutString(std::string_view value);
+
+        void Open(std::string_view key);
+
+        // Writes the header of the innermost container in as few bytes as its length allows.
+        void Close(uint8_t fixed, uint8_t code16, uint8_t code32);
+
+    public:
+
+        explicit MsgPackWriter(OutputSink& sink) : sink_(sink) {
+        }
+
+        void BeginDocument() override;
+
+        void EndDocument() override;
+
+        void BeginSection(std::string_view key) override;
+
+        void EndSection(std::string_view key) override;
+
+        void BeginArray(std::string_view key) override;
+
+        void EndArray(std::string_view key) override;
+
+        void Int(std::string_view key, int64_t value) override;
+
+        void Float(std::string_view key, double value) override;
+
+        void Bool(std::string_view key, bool value) override;
+
+        void String(std::string_view key, std::string_view value) override;
+
+    };
+
+    // Passes every event on to several writers in turn, so one walk of a tree feeds them all.
+    class FanOutWriter : public Writer {
+    private:
+
+        std::vector<Writer*> writers_;
+
+    public:
+
+        explicit FanOutWriter(std::vector<Writer*> writers) : writers_(std::move(writers)) {
+        }
+
+        void BeginDocument() override;
+
+        void EndDocument() override;
+
+        void BeginSection(std::string_view key) override;
+
+        void EndSection(std::string_view key) override;
+
+        void BeginArray(std::string_view key) override;
+
+        void EndArray(std::string_view key) override;
+
+        void Int(std::string_view key, int64_t value) override;
+
+        void Float(std::string_view key, double value) override;
+
+        void Bool(std::string_view key, bool value) override;
+
+        void String(std::string_view key, std::string_view value) override;
+
+    };
+
+    enum class Format : uint8_t {
+        kJson,
+        kYaml,
+        kXml,
+        kMsgPack,
+    };
+
+    // Format named by the extension of path: .json, .yaml or .yml, .xml, .msgpack.
+    std::optional<Format> FormatOf(const std::filesystem::path& path);
+
+    std::unique_ptr<Writer> MakeWriter(Format format, OutputSink& sink);
+
+    // Walks the members of a root section node of the tree with the given base and
+    // reports them to writer.
+    void WriteDocument(const Node& root, uintptr_t base, Writer& writer);
+}
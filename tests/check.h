@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "lib/output.h"
+#include "lib/parser.h"
+
+
+namespace omfl::tests {
+
+    // Failures are counted rather than fatal, so one run reports all of them.
+    inline int failures = 0;
+
+    inline void Check(bool condition, const char* what, const char* file, int line) {
+        if (!condition) {
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+            failures++;
+        }
+    }
+
+    inline std::string Json(const Section& section) {
+        std::string json;
+        StringSink sink(json);
+        section.WriteJSON(sink);
+        return json;
+    }
+
+    inline int Result() {
+        if (failures != 0) {
+            std::fprintf(stderr, "%d checks failed\n", failures);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+}
+
+#define CHECK(condition) omfl::tests::Check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,77 @@
+#include "check.h"
+
+#include <string>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    // Big enough to be cut into chunks: a chunk is at least a megabyte.
+    std::string Sections(size_t count) {
+        std::string text = "name = \"chunked\"\n";
+        for (size_t i = 0; i < count; i++) {
+            std::string section = "s" + std::to_string(i);
+            text += '[' + section + "]\n";
+            for (size_t k = 0; k < 40; k++) {
+                text += "key_" + std::to_string(k) + " = " + std::to_string(i * 40 + k) + '\n';
+            }
+            text += "list = [1, 2.5, \"three\", [true]]\n";
+            text += "text = \"value of " + section + "\"\n";
+            text += '[' + section + ".child]\n";
+            text += "flag = false\n";
+        }
+        return text;
+    }
+
+    // Returns whether the text is valid.
+    bool CheckSame(const std::string& text, bool stop_at_first_error) {
+        ParseOptions sequential;
+        sequential.stop_at_first_error = stop_at_first_error;
+        ParseOptions chunked = sequential;
+        chunked.threads = 4;
+
+        const Document expected = parse(text, sequential);
+        const Document actual = parse(text, chunked);
+        CHECK(actual.valid() == expected.valid());
+        CHECK(Json(actual) == Json(expected));
+        CHECK(actual.errors().size() == expected.errors().size());
+        for (size_t i = 0; i < expected.errors().size() && i < actual.errors().size(); i++) {
+            const ParseError& a = actual.errors()[i];
+            const ParseError& e = expected.errors()[i];
+            CHECK(a.kind == e.kind && a.line == e.line && a.column == e.column && a.text == e.text);
+        }
+        return expected.valid();
+    }
+
+    // Invalid text is also parsed stopping at the first error.
+    void CheckSame(const std::string& text) {
+        if (!CheckSame(text, false)) {
+            CheckSame(text, true);
+        }
+    }
+}
+
+int main() {
+    const std::string text = Sections(6000);
+    CHECK(text.size() > 2 * (1 << 20));
+
+    CHECK(CheckSame(text, false));
+
+    // Sections reopened far from where they started, so in another chunk.
+    CheckSame(text + "[s0]\nlate = 1\n[s0.child.grandchild]\nx = 2\n");
+
+    // A duplicate key, and a key that clashes with a section, across chunks.
+    CheckSame(text + "[s0]\nkey_0 = 1\n");
+    CheckSame(text + "[s1]\nchild = 1\n");
+    CheckSame(text + "[s2.text]\nx = 1\n");
+
+    // Malformed lines and headers in the middle of the text.
+    size_t middle = text.find("[s3000]");
+    CheckSame(text.substr(0, middle) + "broken line\n" + text.substr(middle));
+    CheckSame(text.substr(0, middle) + "[s.]\n" + text.substr(middle));
+    CheckSame(text.substr(0, middle) + "key = [1, 2\n" + text.substr(middle));
+    CheckSame(text + "[\n");
+
+    return Result();
+}
@@ -0,0 +1,85 @@
+#include "check.h"
+
+#include <thread>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    // A section holding `target` after `before` other keys, and `total` keys in all.
+    std::string Layout(size_t before, size_t total, const std::string& value) {
+        std::string text = "[outer]\n";
+        for (size_t i = 0; i < before; i++) {
+            text += "filler_" + std::to_string(i) + " = " + std::to_string(i) + '\n';
+        }
+        text += "[outer.inner]\ntarget = \"" + value + "\"\n[outer]\n";
+        for (size_t i = before; i + 1 < total; i++) {
+            text += "filler_" + std::to_string(i) + " = " + std::to_string(i) + '\n';
+        }
+        return text;
+    }
+
+    void TestMovedKey() {
+        // The same path at positions 0, 2 and 15 of its section, and in sections small
+        // enough to be scanned and big enough to be hashed.
+        const Document first = parse(Layout(0, 3, "first"));
+        const Document second = parse(Layout(2, 3, "second"));
+        const Document third = parse(Layout(15, 20, "third"));
+        const Document missing = parse(std::string("[outer]\nfiller_1 = 2\nfiller_0 = 1\ninner = 3\n"));
+        CHECK(first.valid() && second.valid() && third.valid() && missing.valid());
+
+        CompiledPath path("outer.inner.target");
+        for (int round = 0; round < 3; round++) {
+            CHECK(first.Get(path).AsString() == "first");
+            CHECK(second.Get(path).AsString() == "second");
+            CHECK(third.Get(path).AsString() == "third");
+            CHECK(!missing.Get(path).IsString());
+            CHECK(third.Get(path).AsString() == "third");
+            CHECK(first.Get(path).AsString() == "first");
+        }
+
+        // In `missing`, inner is a value rather than a section, and the filler keys come
+        // before it instead of after.
+        CompiledPath filler("outer.filler_1");
+        CHECK(third.Get(filler).AsInt() == 1);
+        CHECK(first.Get(filler).AsInt() == 1);
+        CHECK(second.Get(filler).AsInt() == 1);
+        CHECK(missing.Get(filler).AsInt() == 2);
+
+        // Copies keep working on their own.
+        CompiledPath copy = path;
+        CHECK(second.Get(copy).AsString() == "second");
+        CHECK(first.Get(path).AsString() == "first");
+    }
+
+    void TestShared() {
+        const Document first = parse(Layout(0, 12, "first"));
+        const Document second = parse(Layout(9, 12, "second"));
+        CompiledPath path("outer.inner.target");
+        std::vector<int> failures(4);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < failures.size(); t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 20000; i++) {
+                    const Document& document = (i + t) % 2 == 0 ? first : second;
+                    std::string_view expected = &document == &first ? "first" : "second";
+                    failures[t] += document.Get(path).AsStringView() != expected;
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (int count : failures) {
+            CHECK(count == 0);
+        }
+    }
+}
+
+int main() {
+    TestMovedKey();
+    TestShared();
+    return Result();
+}
@@ -0,0 +1,126 @@
+#include "check.h"
+
+#include "lib/msgpack.h"
+#include "lib/schema.h"
+
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    struct Port {
+        int32_t port = 0;
+    };
+}
+
+template<>
+struct omfl::Schema<Port> {
+    static constexpr auto kFields = std::make_tuple(Bind("server.port", &Port::port));
+};
+
+namespace {
+
+    struct Expected {
+        const char* text;
+        ErrorKind kind;
+        size_t line;
+        size_t column;
+        const char* span;
+    };
+
+    bool Same(const ParseError& error, ErrorKind kind, size_t line, size_t column, std::string_view span) {
+        return error.kind == kind && error.line == line && error.column == column && error.text == span;
+    }
+
+    void TestTextErrors() {
+        const Expected cases[] = {
+            {"a = 1\nthis is not a line\n", ErrorKind::kInvalidLine, 2, 1, "this is not a line"},
+            {"a = 1\n[bad section\n", ErrorKind::kInvalidLine, 2, 1, "[bad section"},
+            {"[a..b]\n", ErrorKind::kInvalidSection, 1, 1, "[a..b]"},
+            {"x = 1\n[]\n", ErrorKind::kInvalidSection, 2, 1, "[]"},
+            {"  bad key = 1\n", ErrorKind::kInvalidKey, 1, 3, "bad key"},
+            {"= 1\n", ErrorKind::kInvalidKey, 1, 1, "= 1"},
+            {"key =   \n", ErrorKind::kMissingValue, 1, 1, "key ="},
+            {"x = 1\nkey = tru\n", ErrorKind::kInvalidValue, 2, 7, "tru"},
+            {"key = [1, 2\n", ErrorKind::kInvalidValue, 1, 7, "[1, 2"},
+            {"key = \"open\n", ErrorKind::kInvalidValue, 1, 7, "\"open"},
+            {"[s]\nk = 1\nk = 2\n", ErrorKind::kDuplicateKey, 3, 1, "k"},
+            {"[a]\nb = 1\n[a.b]\n", ErrorKind::kSectionConflict, 3, 2, "a.b"},
+            {"a = 1\n[a]\n", ErrorKind::kSectionConflict, 2, 2, "a"},
+            {"[a.b]\n[a]\nb = 1\n", ErrorKind::kSectionConflict, 3, 1, "b"},
+        };
+        for (const Expected& expected : cases) {
+            const Document document = parse(std::string(expected.text));
+            CHECK(!document.valid());
+            CHECK(document.errors().size() == 1);
+            if (!document.errors().empty()) {
+                const ParseError& error = document.errors().front();
+                bool same = Same(error, expected.kind, expected.line, expected.column, expected.span);
+                CHECK(same);
+                if (!same) {
+                    std::fprintf(stderr, "  for %s  got %s %zu:%zu %s\n", expected.text,
+                                 std::string(ErrorKindName(error.kind)).c_str(), error.line, error.column,
+                                 error.text.c_str());
+                }
+            }
+        }
+    }
+
+    void TestUnplacedErrors() {
+        // Errors about an input as a whole have no position and no text.
+        const Document missing = parse(std::filesystem::path("missing.omfl"));
+        CHECK(missing.errors().size() == 1);
+        CHECK(!missing.errors().empty() && Same(missing.errors().front(), ErrorKind::kUnreadableFile, 0, 0, ""));
+
+        const Document binary = load_msgpack(std::string("\x81"));
+        CHECK(binary.errors().size() == 1);
+        CHECK(!binary.errors().empty() && Same(binary.errors().front(), ErrorKind::kMalformedData, 0, 0, ""));
+
+        // Clashes between merged pieces only know the key.
+        std::vector<std::shared_ptr<const Section>> pieces = {
+            std::make_shared<Document>(parse(std::string("[a]\nx = 1\n"))),
+            std::make_shared<Document>(parse(std::string("[a]\nx = 2\n"))),
+        };
+        const Document merged = merge(pieces);
+        CHECK(merged.errors().size() == 1);
+        CHECK(!merged.errors().empty() && Same(merged.errors().front(), ErrorKind::kDuplicateKey, 0, 0, "x"));
+    }
+
+    void TestSchemaErrors() {
+        Port port;
+        std::vector<ParseError> errors = parse_into(std::string("[server]\nport = \"80\"\n"), port);
+        CHECK(errors.size() == 1);
+        CHECK(!errors.empty() && Same(errors.front(), ErrorKind::kTypeMismatch, 2, 1, "port"));
+
+        errors = parse_into(std::string("[client]\nport = 80\n"), port);
+        CHECK(errors.size() == 1);
+        CHECK(!errors.empty() && Same(errors.front(), ErrorKind::kMissingKey, 0, 0, "server.port"));
+    }
+
+    void TestStopAtFirstError() {
+        const std::string text = "a = 1\nb = x\n[c..d]\nc = y\nbad key = 1\n";
+        const Document all = parse(text);
+        CHECK(all.errors().size() == 4);
+
+        ParseOptions options;
+        options.stop_at_first_error = true;
+        const Document first = parse(text, options);
+        CHECK(!first.valid());
+        CHECK(first.errors().size() == 1);
+        CHECK(!first.errors().empty() && Same(first.errors().front(), ErrorKind::kInvalidValue, 2, 5, "x"));
+
+        Port port;
+        std::vector<ParseError> errors = parse_into(std::string("[server]\nport = x\nport = y\n"), port, true);
+        CHECK(errors.size() == 1);
+    }
+}
+
+int main() {
+    TestTextErrors();
+    TestUnplacedErrors();
+    TestSchemaErrors();
+    TestStopAtFirstError();
+    return Result();
+}
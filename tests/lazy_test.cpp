@@ -0,0 +1,170 @@
+#include "check.h"
+
+#include "lib/lazy.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    std::string Describe(const Variable& value) {
+        if (value.IsInt64()) {
+            return "int " + std::to_string(value.AsInt64());
+        }
+        if (value.IsFloat()) {
+            return "float " + std::to_string(value.AsFloat());
+        }
+        if (value.IsBool()) {
+            return value.AsBool() ? "true" : "false";
+        }
+        if (value.IsString()) {
+            return "string " + value.AsString();
+        }
+        if (value.IsArray() || value.IsSection()) {
+            std::string description = value.IsArray() ? "array" : "section";
+            description += " of " + std::to_string(value.Size());
+            for (size_t i = 0; value.IsArray() && i < value.Size(); i++) {
+                description += ", " + Describe(value[i]);
+            }
+            return description;
+        }
+        return "none";
+    }
+
+    std::string Errors(const std::vector<ParseError>& errors) {
+        std::string description;
+        for (const ParseError& error : errors) {
+            description += std::string(ErrorKindName(error.kind)) + ' ' + std::to_string(error.line) + ':' +
+                           std::to_string(error.column) + ' ' + error.text + '\n';
+        }
+        return description;
+    }
+
+    // Every path must read the same from the lazy document as from a full parse, and
+    // once all sections have been read the errors must be the same too.
+    void CheckSame(const std::string& text, const std::vector<std::string>& paths) {
+        const Document full = parse(text);
+        LazyDocument lazy(text);
+        for (const std::string& path : paths) {
+            CHECK(Describe(lazy.Get(path)) == Describe(full.Get(path)));
+            CHECK(Describe(lazy.Get(CompiledPath(path))) == Describe(full.Get(CompiledPath(path))));
+        }
+        CHECK(lazy.valid() == full.valid());
+        CHECK(Errors(lazy.errors()) == Errors(full.errors()));
+    }
+
+    void TestReopened() {
+        const std::string text =
+            "root = 1\n"
+            "list = [1, [2.5, \"x\"]]\n"
+            "[a]\nx = 1\n"
+            "[b]\ny = \"two\"\n"
+            "[a.c]\nw = true\n"
+            "[b.d.e]\nv = [1, 2]\n"
+            "[a]\nz = 3\n"
+            "[b.d]\nu = 4\n"
+            "[a.c]\nt = -5\n";
+        CheckSame(text, {"root", "list", "a", "a.x", "a.z", "a.c", "a.c.w", "a.c.t", "b", "b.y", "b.d", "b.d.u",
+                         "b.d.e", "b.d.e.v", "a.missing", "missing", "missing.x", "root.x"});
+
+        // A top-level section named only as the parent of others.
+        CheckSame("[p.q]\nx = 1\n[r]\n[p.s]\ny = 2\n", {"p", "p.q.x", "p.s.y", "r"});
+    }
+
+    void TestConflicts() {
+        // A root key named like a section is found on opening, before any section is read.
+        const std::string clash = "a = 1\nb = 2\n[c]\nx = 1\n[a]\ny = 2\n";
+        LazyDocument lazy(clash);
+        CHECK(!lazy.valid());
+        CHECK(Errors(lazy.errors()) == Errors(parse(clash).errors()));
+        CheckSame(clash, {"b", "c.x"});
+
+        // Problems inside a section are only found once it is read.
+        const std::string duplicate = "k = 1\n[a]\nx = 1\n[b]\ny = 1\n[a]\nx = 2\n";
+        LazyDocument later(duplicate);
+        CHECK(later.valid());
+        CHECK(later.Get("b.y").AsInt() == 1);
+        CHECK(later.valid());
+        later.Get("a.x");
+        CHECK(!later.valid());
+        CHECK(Errors(later.errors()) == Errors(parse(duplicate).errors()));
+
+        CheckSame("[a]\nx = 1\n[a.x]\ny = 2\n", {"a.x"});
+        CheckSame("[a]\nbroken line\n[b]\n[a..c]\n", {"a", "b"});
+    }
+
+    void TestThreads() {
+        std::string text = "root = 0\n";
+        for (int i = 0; i < 50; i++) {
+            text += "[s" + std::to_string(i) + "]\n";
+            for (int k = 0; k < 200; k++) {
+                text += "k" + std::to_string(k) + " = \"" + std::to_string(i * 1000 + k) + "\"\n";
+            }
+            text += "[s" + std::to_string(i) + ".child]\nv = " + std::to_string(i) + '\n';
+        }
+        const Document full = parse(text);
+
+        for (int round = 0; round < 20; round++) {
+            LazyDocument lazy(text);
+            constexpr int kThreads = 8;
+            std::atomic<int> ready{0};
+            std::vector<std::string_view> seen(kThreads);
+            std::vector<int> failures(kThreads);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < kThreads; t++) {
+                threads.emplace_back([&, t] {
+                    ready++;
+                    while (ready < kThreads) {
+                    }
+                    // All threads ask for the same section before anyone has built it.
+                    std::string section = "s" + std::to_string(round);
+                    seen[t] = lazy.Get(section + ".k7").AsStringView();
+                    for (int k = 0; k < 200; k += 13) {
+                        std::string path = section + ".k" + std::to_string(k);
+                        failures[t] += Describe(lazy.Get(path)) != Describe(full.Get(path));
+                    }
+                    failures[t] += lazy.Get(section + ".child.v").AsInt() != round;
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            for (int t = 0; t < kThreads; t++) {
+                CHECK(failures[t] == 0);
+                // The section was built once, so every thread got the same string.
+                CHECK(seen[t].data() == seen[0].data());
+            }
+            CHECK(lazy.valid());
+        }
+    }
+
+    void TestFile() {
+        const std::string text = "x = 1\n[a]\ny = 2\n[b.c]\nz = \"three\"\n[a]\nw = 4\n";
+        {
+            std::ofstream file("lazy.omfl", std::ios::binary | std::ios::trunc);
+            file << text;
+        }
+        LazyDocument lazy(std::filesystem::path("lazy.omfl"));
+        CHECK(lazy.Get("x").AsInt() == 1);
+        CHECK(lazy.Get("a.w").AsInt() == 4);
+        CHECK(lazy.Get("b.c.z").AsString() == "three");
+        CHECK(lazy.valid());
+
+        LazyDocument missing(std::filesystem::path("missing.omfl"));
+        CHECK(!missing.valid());
+        CHECK(missing.errors().size() == 1 && missing.errors().front().kind == ErrorKind::kUnreadableFile);
+    }
+}
+
+int main() {
+    TestReopened();
+    TestConflicts();
+    TestThreads();
+    TestFile();
+    return Result();
+}
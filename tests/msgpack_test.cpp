@@ -0,0 +1,102 @@
+#include "check.h"
+
+#include "lib/msgpack.h"
+
+#include <fstream>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    const std::string kText =
+        "small = 7\n"
+        "negative = -100000\n"
+        "big = 9000000000\n"
+        "ratio = 0.1\n"
+        "enabled = false\n"
+        "name = \"\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82\"\n"
+        "ints = [1, -2, 300000]\n"
+        "floats = [1.5, -0.25]\n"
+        "bools = [true, false, true]\n"
+        "mixed = [1, \"two\", [3.5, [false]], []]\n"
+        "empty = []\n"
+        "[server]\n"
+        "host = \"localhost\"\n"
+        "[server.limits.inner]\n"
+        "rate = 0.000001\n";
+
+    std::string MsgPack(const Section& section) {
+        std::string bytes;
+        StringSink sink(bytes);
+        section.WriteMsgPack(sink);
+        return bytes;
+    }
+
+    bool FailedOnce(const Document& document, ErrorKind kind) {
+        return !document.valid() && document.errors().size() == 1 && document.errors().front().kind == kind;
+    }
+
+    void TestRoundTrip() {
+        const Document document = parse(kText);
+        CHECK(document.valid());
+        std::string bytes = MsgPack(document);
+
+        const Document loaded = load_msgpack(bytes);
+        CHECK(loaded.valid());
+        CHECK(Json(loaded) == Json(document));
+        CHECK(MsgPack(loaded) == bytes);
+        CHECK(loaded.Get("big").AsInt64() == 9000000000);
+        CHECK(loaded.Get("ratio").AsFloatOrDefault(0) == 0.1f);
+        CHECK(loaded.Get("ints").AsIntSpan().size() == 3);
+        CHECK(loaded.Get("mixed")[2][1][0].IsBool());
+        CHECK(loaded.Get("server.limits.inner.rate").IsFloat());
+
+        const Document empty = load_msgpack(MsgPack(parse(std::string())));
+        CHECK(empty.valid());
+        CHECK(Json(empty) == Json(parse(std::string())));
+    }
+
+    void TestTruncated() {
+        std::string bytes = MsgPack(parse(kText));
+        const std::string empty_json = Json(load_msgpack(std::string()));
+        for (size_t size = 0; size < bytes.size(); size++) {
+            const Document loaded = load_msgpack(bytes.substr(0, size));
+            CHECK(FailedOnce(loaded, ErrorKind::kMalformedData));
+            CHECK(Json(loaded) == empty_json);
+        }
+        CHECK(FailedOnce(load_msgpack(bytes + '\xc0'), ErrorKind::kMalformedData));
+    }
+
+    void TestRejected() {
+        // The root has to be a map.
+        CHECK(FailedOnce(load_msgpack(std::string("\x93\x01\x02\x03")), ErrorKind::kMalformedData));
+        // Nil values have no OMFL type.
+        CHECK(FailedOnce(load_msgpack(std::string("\x81\xa1k\xc0")), ErrorKind::kMalformedData));
+        // {"a b": 1} and {"k": 1, "k": 2}.
+        CHECK(FailedOnce(load_msgpack(std::string("\x81\xa3" "a b\x01")), ErrorKind::kInvalidKey));
+        CHECK(FailedOnce(load_msgpack(std::string("\x82\xa1k\x01\xa1k\x02")), ErrorKind::kDuplicateKey));
+        // An array holding a map.
+        CHECK(FailedOnce(load_msgpack(std::string("\x81\xa1k\x91\x80", 5)), ErrorKind::kMalformedData));
+    }
+
+    void TestFile() {
+        std::string bytes = MsgPack(parse(kText));
+        {
+            std::ofstream file("document.msgpack", std::ios::binary | std::ios::trunc);
+            file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        const Document loaded = load_msgpack(std::filesystem::path("document.msgpack"));
+        CHECK(loaded.valid());
+        CHECK(Json(loaded) == Json(parse(kText)));
+        CHECK(FailedOnce(load_msgpack(std::filesystem::path("missing.msgpack")), ErrorKind::kUnreadableFile));
+    }
+}
+
+int main() {
+    TestRoundTrip();
+    TestTruncated();
+    TestRejected();
+    TestFile();
+    return Result();
+}
@@ -0,0 +1,120 @@
+#include "check.h"
+
+#include "lib/msgpack.h"
+#include "lib/snapshot.h"
+
+#include <stdexcept>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    const std::string kText =
+        "ints = [1, -2, 9000000000, +4]\n"
+        "floats = [1.5, -0.25, 3.0]\n"
+        "bools = [true, false, false, true]\n"
+        "empty = []\n"
+        "mixed_numbers = [1, 2.5]\n"
+        "mixed_types = [1, \"x\"]\n"
+        "strings = [\"a\", \"b\"]\n"
+        "nested = [[1, 2], [0.5], [true]]\n"
+        "scalar = 7\n"
+        "[section]\n"
+        "key = 1\n";
+
+    template<typename Get>
+    bool Throws(Get get) {
+        try {
+            get();
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    }
+
+    void CheckDocument(const Section& document) {
+        Span<int64_t> ints = document.Get("ints").AsIntSpan();
+        CHECK((std::vector<int64_t>(ints.begin(), ints.end()) == std::vector<int64_t>{1, -2, 9000000000, 4}));
+        Span<double> floats = document.Get("floats").AsFloatSpan();
+        CHECK((std::vector<double>(floats.begin(), floats.end()) == std::vector<double>{1.5, -0.25, 3.0}));
+
+        CHECK(document.Get("empty").AsIntSpan().empty());
+        CHECK(document.Get("empty").AsFloatSpan().empty());
+
+        Variable nested = document.Get("nested");
+        CHECK(nested[0].AsIntSpan().size() == 2 && nested[0].AsIntSpan()[1] == 2);
+        CHECK(nested[1].AsFloatSpan().size() == 1 && nested[1].AsFloatSpan()[0] == 0.5);
+
+        // Anything but an array of ints or of floats throws from both getters.
+        for (const char* path : {"mixed_numbers", "mixed_types", "strings", "bools", "nested", "scalar", "section",
+                                 "missing"}) {
+            CHECK(Throws([&] { document.Get(path).AsIntSpan(); }));
+            CHECK(Throws([&] { document.Get(path).AsFloatSpan(); }));
+        }
+        CHECK(Throws([&] { document.Get("ints").AsFloatSpan(); }));
+        CHECK(Throws([&] { document.Get("floats").AsIntSpan(); }));
+        CHECK(Throws([&] { nested[2].AsIntSpan(); }));
+
+        // Elements of packed arrays answer like values with a node of their own.
+        Variable bools = document.Get("bools");
+        const bool expected[] = {true, false, false, true};
+        CHECK(bools.IsArray() && bools.Size() == 4);
+        for (size_t i = 0; i < 4; i++) {
+            CHECK(bools[i].IsBool());
+            CHECK(bools[i].AsBool() == expected[i]);
+            CHECK(!bools[i].IsInt() && !bools[i].IsArray() && bools[i].Size() == 0);
+        }
+        CHECK(!bools[4].IsBool());
+        CHECK(!bools[0][0].IsBool());
+        CHECK(nested[2][0].AsBool());
+
+        Variable first = document.Get("ints")[0];
+        CHECK(first.IsInt() && first.AsInt() == 1 && first.AsInt64() == 1);
+        CHECK(!first.IsFloat() && !first.IsString());
+        CHECK(document.Get("ints")[2].IsInt64() && !document.Get("ints")[2].IsInt());
+        CHECK(document.Get("ints")[2].AsInt64OrDefault(0) == 9000000000);
+        CHECK(document.Get("floats")[1].AsFloat() == -0.25f);
+        CHECK(document.Get("floats")[1].AsIntOrDefault(5) == 5);
+        CHECK(Throws([&] { first.AsString(); }));
+        CHECK(Throws([&] { first.AsBool(); }));
+        CHECK(Throws([&] { bools[0].AsInt(); }));
+    }
+
+    void TestParsed() {
+        const Document document = parse(kText);
+        CHECK(document.valid());
+        CheckDocument(document);
+    }
+
+    void TestCopies() {
+        // Every way to build or copy a document keeps arrays packed.
+        const Document document = parse(kText);
+        CheckDocument(document.Clone());
+
+        std::string bytes;
+        StringSink sink(bytes);
+        document.WriteMsgPack(sink);
+        CheckDocument(load_msgpack(bytes));
+
+        CHECK(save_snapshot(document, "packed.snap", HashSource(kText)));
+        std::optional<Document> snapshot = load_snapshot("packed.snap", HashSource(kText));
+        CHECK(snapshot.has_value());
+        if (snapshot) {
+            CheckDocument(*snapshot);
+        }
+
+        std::vector<std::shared_ptr<const Section>> pieces = {
+            std::make_shared<Document>(parse(kText.substr(0, kText.find("[section]")))),
+            std::make_shared<Document>(parse(kText.substr(kText.find("[section]")))),
+        };
+        CheckDocument(merge(pieces));
+    }
+}
+
+int main() {
+    TestParsed();
+    TestCopies();
+    return Result();
+}
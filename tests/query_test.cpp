@@ -0,0 +1,136 @@
+#include "check.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    const std::string kText =
+        "timeout = 5\n"
+        "port = 1\n"
+        "[servers]\n"
+        "port = 2\n"
+        "[servers.alpha]\n"
+        "port = 8080\n"
+        "timeout = 30\n"
+        "[servers.beta]\n"
+        "port = 8081\n"
+        "[servers.beta.limits]\n"
+        "timeout = 1.5\n"
+        "[servers.gamma]\n"
+        "host = \"none\"\n"
+        "[srv1]\n"
+        "port = 9001\n"
+        "[srv2]\n"
+        "port = 9002\n"
+        "[srv2.timeout]\n"
+        "inner = 1\n"
+        "[other]\n"
+        "srv3 = 3\n"
+        "[other.deep.deeper]\n"
+        "timeout = \"late\"\n";
+
+    std::vector<std::string> Matches(const Section& document, std::string_view pattern) {
+        std::vector<std::string> paths;
+        for (const QueryMatch& match : document.Query(pattern)) {
+            paths.push_back(match.path);
+            // A match is the node Get finds at its path.
+            CHECK(&match.value.node() == &document.Get(match.path).node());
+        }
+        std::sort(paths.begin(), paths.end());
+        CHECK(std::adjacent_find(paths.begin(), paths.end()) == paths.end());
+        return paths;
+    }
+
+    void TestPatterns() {
+        const Document plain = parse(kText);
+        ParseOptions options;
+        options.index_paths = true;
+        const Document indexed = parse(kText, options);
+        CHECK(plain.valid() && indexed.valid());
+
+        const std::pair<const char*, std::vector<std::string>> cases[] = {
+            {"servers.*.port", {"servers.alpha.port", "servers.beta.port"}},
+            {"**.timeout", {"other.deep.deeper.timeout", "servers.alpha.timeout", "servers.beta.limits.timeout",
+                            "srv2.timeout", "timeout"}},
+            {"srv*.port", {"srv1.port", "srv2.port"}},
+            {"srv*", {"srv1", "srv2"}},
+            {"other.srv*", {"other.srv3"}},
+            // `**` standing for no names at all.
+            {"servers.**.port", {"servers.alpha.port", "servers.beta.port", "servers.port"}},
+            {"**.port", {"port", "servers.alpha.port", "servers.beta.port", "servers.port", "srv1.port",
+                         "srv2.port"}},
+            {"servers.beta.**.timeout", {"servers.beta.limits.timeout"}},
+            {"**.beta.**", {"servers.beta", "servers.beta.limits", "servers.beta.limits.timeout",
+                            "servers.beta.port"}},
+            {"*.*.timeout", {"servers.alpha.timeout"}},
+            {"**.deeper.*", {"other.deep.deeper.timeout"}},
+            {"**.missing", {}},
+            {"servers.*.missing", {}},
+            {"timeout", {"timeout"}},
+            {"port.*", {}},
+        };
+        for (const auto& [pattern, expected] : cases) {
+            std::vector<std::string> found = Matches(plain, pattern);
+            CHECK(found == expected);
+            CHECK(Matches(indexed, pattern) == found);
+            if (found != expected) {
+                std::fprintf(stderr, "  for %s got %zu matches\n", pattern, found.size());
+            }
+        }
+
+        // Indexing a document afterwards gives the same answers.
+        Document later = parse(kText);
+        later.IndexPaths();
+        for (const auto& [pattern, expected] : cases) {
+            CHECK(Matches(later, pattern) == expected);
+        }
+    }
+
+    void TestGenerated() {
+        // Names repeated at many depths, so `**` has many candidates to check.
+        std::string text = "name = 0\n";
+        for (int i = 0; i < 40; i++) {
+            std::string section = "[n" + std::to_string(i % 7);
+            for (int depth = 0; depth < i % 5; depth++) {
+                section += ".name" + std::to_string(depth % 2) + ".n" + std::to_string((i + depth) % 3);
+            }
+            text += section + ".x" + std::to_string(i) + "]\nname = " + std::to_string(i) + "\nn1 = [1]\nname0 = true\n";
+        }
+        const Document plain = parse(text);
+        ParseOptions options;
+        options.index_paths = true;
+        const Document indexed = parse(text, options);
+        CHECK(plain.valid());
+        for (const char* pattern : {"**.name", "**.n1", "**.name0.**.name", "n*.**.n1", "**.n2.*", "*.**.name1.*",
+                                    "**.**.name", "**", "n0.**", "**.name0"}) {
+            std::vector<std::string> found = Matches(plain, pattern);
+            CHECK(Matches(indexed, pattern) == found);
+        }
+        CHECK(Matches(plain, "**.name").size() > 40);
+    }
+
+    void TestInvalidPatterns() {
+        const Document document = parse(kText);
+        for (const char* pattern : {"a..b", "a*b", "", ".", "a.", ".a", "*a", "a.**b", "a.b*c.d"}) {
+            bool thrown = false;
+            try {
+                document.Query(pattern);
+            } catch (const std::invalid_argument&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+    }
+}
+
+int main() {
+    TestPatterns();
+    TestGenerated();
+    TestInvalidPatterns();
+    return Result();
+}
@@ -0,0 +1,187 @@
+#include "check.h"
+
+#include "lib/reload.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    constexpr size_t kSections = 2000;
+
+    // Many small sections, so the text is cut into many pieces. `version` goes into the
+    // first and the last section, and `edited` gets a different name.
+    std::string Text(size_t version, size_t edited = kSections) {
+        std::string text = "version = " + std::to_string(version) + '\n';
+        for (size_t i = 0; i < kSections; i++) {
+            text += "[s" + std::to_string(i) + "]\n";
+            text += "name = \"section " + std::to_string(i) + (i == edited ? " edited" : "") + "\"\n";
+            text += "value = " + std::to_string(i) + "\nlist = [1, 2.5, \"three\"]\n";
+        }
+        return text + "version = " + std::to_string(version) + '\n';
+    }
+
+    void WriteFile(const std::filesystem::path& path, const std::string& text) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    std::string Name(size_t section) {
+        return "s" + std::to_string(section) + ".name";
+    }
+
+    void TestReparsesChangedPiece() {
+        WriteFile("pieces.omfl", Text(1));
+        ReloadableDocument document("pieces.omfl");
+        std::shared_ptr<const Section> before = document.Current();
+        CHECK(before->valid());
+        CHECK(Json(*before) == Json(parse(Text(1))));
+
+        const size_t edited = kSections / 2;
+        WriteFile("pieces.omfl", Text(1, edited));
+        CHECK(document.Reload());
+        std::shared_ptr<const Section> after = document.Current();
+        CHECK(after != before);
+        CHECK(Json(*after) == Json(parse(Text(1, edited))));
+        CHECK(after->Get(Name(edited)).AsString() == "section " + std::to_string(edited) + " edited");
+        CHECK(before->Get(Name(edited)).AsString() == "section " + std::to_string(edited));
+
+        // Strings of a piece that was not parsed again stay where they were. The ones that
+        // moved are the sections of the edited piece: one run around the edit.
+        size_t first = kSections;
+        size_t last = 0;
+        size_t moved = 0;
+        for (size_t i = 0; i < kSections; i++) {
+            if (before->Get(Name(i)).AsStringView().data() != after->Get(Name(i)).AsStringView().data()) {
+                first = std::min(first, i);
+                last = std::max(last, i);
+                moved++;
+            }
+        }
+        CHECK(moved > 0 && first <= edited && edited <= last);
+        CHECK(moved == last - first + 1);
+        CHECK(moved < kSections / 10);
+
+        // Reloading the same text parses nothing and still gives an equal document.
+        CHECK(document.Reload());
+        CHECK(document.Current()->Get(Name(0)).AsStringView().data() == after->Get(Name(0)).AsStringView().data());
+        CHECK(Json(*document.Current()) == Json(*after));
+    }
+
+    void TestInvalidEdit() {
+        WriteFile("invalid.omfl", Text(1));
+        ReloadableDocument document("invalid.omfl");
+        std::shared_ptr<const Section> valid = document.Current();
+        CHECK(valid->valid());
+
+        // A broken line, and a duplicate key that only shows when the pieces are merged.
+        for (const std::string& text : {Text(1) + "broken line\n", Text(1) + "[s0]\nvalue = 1\n"}) {
+            WriteFile("invalid.omfl", text);
+            CHECK(!parse(text).valid());
+            CHECK(!document.Reload());
+            CHECK(document.Current() == valid);
+        }
+
+        WriteFile("invalid.omfl", Text(2));
+        CHECK(document.Reload());
+        CHECK(document.Current()->Get("version").AsInt() == 2);
+        CHECK(Json(*document.Current()) == Json(parse(Text(2))));
+
+        // A file that starts out invalid leaves the empty document in place until the
+        // first valid text.
+        WriteFile("invalid.omfl", "broken line\n");
+        ReloadableDocument broken("invalid.omfl");
+        CHECK(broken.Current()->valid());
+        CHECK(Json(*broken.Current()) == Json(parse(std::string())));
+        WriteFile("invalid.omfl", Text(3));
+        CHECK(broken.Reload());
+        CHECK(broken.Current()->valid());
+    }
+
+    void TestReadersDuringReload() {
+        WriteFile("readers.omfl", Text(0));
+        ReloadableDocument document("readers.omfl");
+        std::atomic<bool> done{false};
+        std::atomic<int> failures{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    // Both ends of one snapshot come from the same version of the text.
+                    std::shared_ptr<const Section> current = document.Current();
+                    int64_t version = current->Get("version").AsInt64();
+                    std::string last = current->Get("s" + std::to_string(kSections - 1) + ".name").AsString();
+                    if (!current->valid() || last != "section " + std::to_string(kSections - 1) ||
+                        Json(*current).find("\"version\": " + std::to_string(version)) == std::string::npos) {
+                        failures++;
+                    }
+                }
+            });
+        }
+        for (size_t version = 1; version <= 20; version++) {
+            WriteFile("readers.omfl", Text(version, version));
+            CHECK(document.Reload());
+            CHECK(document.Current()->Get("version").AsInt() == static_cast<int32_t>(version));
+        }
+        done = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        CHECK(failures == 0);
+    }
+
+    // Waits for the watcher to publish `version`.
+    bool WaitForVersion(ReloadableDocument& document, int32_t version) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (std::chrono::steady_clock::now() < deadline) {
+            if (document.Current()->Get("version").AsIntOrDefault(-1) == version) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    void TestWatch() {
+        std::filesystem::create_directories("watched");
+        WriteFile("watched/config.omfl", Text(1));
+        ReloadableDocument document("watched/config.omfl");
+        std::atomic<int> published{0};
+        document.Watch([&](std::shared_ptr<const Section> section) {
+            if (section->valid()) {
+                published++;
+            }
+        });
+        // Give the watcher time to set up before the first change.
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        // Written in place, then saved the way editors do: a new file renamed over it.
+        WriteFile("watched/config.omfl", Text(2));
+        CHECK(WaitForVersion(document, 2));
+        WriteFile("watched/config.omfl.tmp", Text(3));
+        std::filesystem::rename("watched/config.omfl.tmp", "watched/config.omfl");
+        CHECK(WaitForVersion(document, 3));
+
+        // An invalid save is never published.
+        WriteFile("watched/config.omfl", "broken line\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        CHECK(document.Current()->Get("version").AsInt() == 3);
+        document.StopWatching();
+        CHECK(published >= 2);
+        CHECK(Json(*document.Current()) == Json(parse(Text(3))));
+    }
+}
+
+int main() {
+    TestReparsesChangedPiece();
+    TestInvalidEdit();
+    TestReadersDuringReload();
+    TestWatch();
+    return Result();
+}
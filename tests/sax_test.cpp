@@ -0,0 +1,162 @@
+#include "check.h"
+
+#include "lib/sax.h"
+
+#include <fstream>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    const std::string kText =
+        "# leading comment\n"
+        "title = \"a [bracketed] string with = and # inside\"\n"
+        "count = -42\n"
+        "ratio = +3.25  # trailing comment\n"
+        "flags = [true, false]\n"
+        "nested = [1, [2.5, [\"deep\", []]], \"x\"]\n"
+        "\n"
+        "[server.limits]\n"
+        "  max = 100\n"
+        "broken = [1, 2\n"
+        "[a.b.c]\n"
+        "name = \"last\"\n"
+        "bad key = 1\n"
+        "tail = 7";
+
+    // Every event as one line of text, errors with their position.
+    class Recorder : public SaxHandler {
+    public:
+
+        std::vector<std::string> events;
+        bool stop_at_error = false;
+
+        void OnSection(std::string_view path) override {
+            events.push_back("section " + std::string(path));
+        }
+
+        bool OnKey(std::string_view key) override {
+            events.push_back("key " + std::string(key));
+            return true;
+        }
+
+        void OnInt(int64_t value) override {
+            events.push_back("int " + std::to_string(value));
+        }
+
+        void OnFloat(double value) override {
+            events.push_back("float " + std::to_string(value));
+        }
+
+        void OnBool(bool value) override {
+            events.push_back(value ? "true" : "false");
+        }
+
+        void OnString(std::string_view value) override {
+            events.push_back("string " + std::string(value));
+        }
+
+        void OnArrayBegin() override {
+            events.push_back("[");
+        }
+
+        void OnArrayEnd() override {
+            events.push_back("]");
+        }
+
+        bool OnError(const ParseError& error) override {
+            events.push_back("error " + std::string(ErrorKindName(error.kind)) + ' ' + std::to_string(error.line) +
+                             ':' + std::to_string(error.column) + ' ' + error.text);
+            return !stop_at_error;
+        }
+
+    };
+
+    // Feeds the text cut at the given offsets, in increasing order.
+    std::vector<std::string> Events(std::string_view text, const std::vector<size_t>& cuts, bool* valid = nullptr,
+                                    bool stop_at_error = false) {
+        Recorder recorder;
+        recorder.stop_at_error = stop_at_error;
+        SaxParser parser(recorder);
+        size_t begin = 0;
+        for (size_t cut : cuts) {
+            parser.Feed(text.substr(begin, cut - begin));
+            begin = cut;
+        }
+        parser.Feed(text.substr(begin));
+        parser.Finish();
+        if (valid != nullptr) {
+            *valid = parser.valid();
+        }
+        return recorder.events;
+    }
+
+    void TestChunkings(const std::string& text) {
+        Recorder whole;
+        bool whole_valid = parse(text, whole);
+        CHECK(!whole.events.empty());
+
+        // One byte at a time.
+        std::vector<size_t> bytes;
+        for (size_t i = 1; i < text.size(); i++) {
+            bytes.push_back(i);
+        }
+        bool valid = true;
+        CHECK(Events(text, bytes, &valid) == whole.events);
+        CHECK(valid == whole_valid);
+
+        // Two chunks, cut at every offset: inside strings, arrays, headers and comments,
+        // and right before and after newlines.
+        for (size_t cut = 0; cut <= text.size(); cut++) {
+            CHECK(Events(text, {cut}) == whole.events);
+        }
+
+        // Cuts inside a string, an array and a [a.b] header at once, and empty chunks.
+        std::vector<size_t> cuts = {text.find("bracketed"), text.find("2.5"), text.find("b.c]"), text.find("b.c]")};
+        CHECK(Events(text, cuts) == whole.events);
+
+        // Chunks of every size up to a few lines.
+        for (size_t size = 2; size < 64; size++) {
+            std::vector<size_t> sized;
+            for (size_t i = size; i < text.size(); i += size) {
+                sized.push_back(i);
+            }
+            CHECK(Events(text, sized) == whole.events);
+        }
+    }
+
+    void TestStop() {
+        // A handler that stops at the first error gets nothing after it.
+        std::vector<std::string> events = Events(kText, {}, nullptr, true);
+        CHECK(!events.empty() && events.back().rfind("error", 0) == 0);
+        CHECK(Events(kText, {kText.find("max"), kText.find("broken") + 3}, nullptr, true) == events);
+    }
+
+    void TestFile() {
+        // parse(path) reads in fixed-size chunks, so a long text is cut at arbitrary places.
+        std::string text;
+        for (int i = 0; i < 5000; i++) {
+            text += "[s" + std::to_string(i) + "]\nkey = \"value " + std::to_string(i) + "\"\nlist = [1, 2, 3]\n";
+        }
+        {
+            std::ofstream file("sax.omfl", std::ios::binary | std::ios::trunc);
+            file << text;
+        }
+        Recorder from_file;
+        Recorder from_string;
+        CHECK(parse(std::filesystem::path("sax.omfl"), from_file));
+        CHECK(parse(text, from_string));
+        CHECK(from_file.events == from_string.events);
+        CHECK(from_file.events.size() == 5000 * 9);
+    }
+}
+
+int main() {
+    TestChunkings(kText);
+    TestChunkings(kText + '\n');
+    TestStop();
+    TestFile();
+    return Result();
+}
@@ -0,0 +1,159 @@
+#include "check.h"
+
+#include "lib/schema.h"
+
+#include <fstream>
+#include <vector>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    struct Config {
+        std::string name;
+        bool debug = false;
+        int32_t port = 0;
+        uint8_t retries = 0;
+        double ratio = 0;
+        std::vector<std::string> hosts;
+        std::vector<int64_t> limits;
+        float timeout = 0;
+    };
+}
+
+template<>
+struct omfl::Schema<Config> {
+    static constexpr auto kFields = std::make_tuple(
+        Bind("name", &Config::name),
+        Bind("debug", &Config::debug),
+        Bind("server.port", &Config::port),
+        Bind("server.retries", &Config::retries),
+        Bind("server.tuning.ratio", &Config::ratio),
+        Bind("server.hosts", &Config::hosts),
+        Bind("limits.deep.nested.values", &Config::limits),
+        Bind("client.timeout", &Config::timeout));
+};
+
+namespace {
+
+    const std::string kText =
+        "name = \"service\"\n"
+        "debug = true\n"
+        "unrelated = [1, [\"skipped\"]]\n"
+        "[server]\n"
+        "port = 8080\n"
+        "retries = 3\n"
+        "hosts = [\"a\", \"b\"]\n"
+        "[server.tuning]\n"
+        "ratio = 0.75\n"
+        "[limits.deep.nested]\n"
+        "values = [1, -2, 9000000000]\n"
+        "[client]\n"
+        "timeout = 1.5\n";
+
+    bool HasError(const std::vector<ParseError>& errors, ErrorKind kind, std::string_view text) {
+        for (const ParseError& error : errors) {
+            if (error.kind == kind && error.text == text) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TestBind() {
+        Config config;
+        std::vector<ParseError> errors = parse_into(kText, config);
+        CHECK(errors.empty());
+        CHECK(config.name == "service");
+        CHECK(config.debug);
+        CHECK(config.port == 8080);
+        CHECK(config.retries == 3);
+        CHECK(config.ratio == 0.75);
+        CHECK((config.hosts == std::vector<std::string>{"a", "b"}));
+        CHECK((config.limits == std::vector<int64_t>{1, -2, 9000000000}));
+        CHECK(config.timeout == 1.5f);
+
+        // The same values as a parsed document.
+        const Document document = parse(kText);
+        CHECK(config.port == document.Get("server.port").AsInt());
+        CHECK(config.ratio == document.Get("server.tuning.ratio").AsFloat());
+        CHECK(config.limits[2] == document.Get("limits.deep.nested.values")[2].AsInt64());
+
+        {
+            std::ofstream file("schema.omfl", std::ios::binary | std::ios::trunc);
+            file << kText;
+        }
+        Config from_file;
+        CHECK(parse_into(std::filesystem::path("schema.omfl"), from_file).empty());
+        CHECK(from_file.hosts == config.hosts && from_file.timeout == config.timeout);
+    }
+
+    // Replaces the first occurrence of `from` in the text.
+    std::string Edit(std::string_view from, std::string_view to) {
+        std::string text = kText;
+        text.replace(text.find(from), from.size(), to);
+        return text;
+    }
+
+    void TestMismatch() {
+        const std::pair<std::string, std::string> cases[] = {
+            {Edit("port = 8080", "port = \"8080\""), "port"},
+            {Edit("port = 8080", "port = 1.5"), "port"},
+            {Edit("port = 8080", "port = [8080]"), "port"},
+            {Edit("retries = 3", "retries = 300"), "retries"},
+            {Edit("retries = 3", "retries = -1"), "retries"},
+            {Edit("debug = true", "debug = 1"), "debug"},
+            {Edit("ratio = 0.75", "ratio = 1"), "ratio"},
+            {Edit("[\"a\", \"b\"]", "\"a\""), "hosts"},
+            {Edit("[\"a\", \"b\"]", "[\"a\", 2]"), "hosts"},
+            {Edit("[\"a\", \"b\"]", "[[\"a\"]]"), "hosts"},
+        };
+        for (const auto& [text, key] : cases) {
+            Config config;
+            std::vector<ParseError> errors = parse_into(text, config);
+            CHECK(errors.size() == 1);
+            CHECK(HasError(errors, ErrorKind::kTypeMismatch, key));
+            CHECK(errors.empty() || errors.front().line > 0);
+        }
+    }
+
+    void TestMissing() {
+        Config config;
+        config.port = 1;
+        // Neither a key at another path nor a section at the path counts.
+        std::string text = Edit("port = 8080\n", "");
+        text.replace(text.find("ratio = 0.75\n"), 13, "[server.tuning.ratio]\n");
+        std::vector<ParseError> errors = parse_into(text + "[other]\nport = 2\n", config);
+        CHECK(errors.size() == 2);
+        CHECK(HasError(errors, ErrorKind::kMissingKey, "server.port"));
+        CHECK(HasError(errors, ErrorKind::kMissingKey, "server.tuning.ratio"));
+        CHECK(errors.empty() || (errors.front().line == 0 && errors.front().column == 0));
+        CHECK(config.port == 1);
+        CHECK(config.retries == 3);
+
+        // An empty text misses every field, unless the parse stops at the first error.
+        Config empty;
+        CHECK(parse_into(std::string(), empty).size() == std::tuple_size_v<decltype(Schema<Config>::kFields)>);
+        CHECK(parse_into(std::string(), empty, true).size() == 1);
+
+        // Errors of the text come first.
+        errors = parse_into(Edit("port = 8080\n", "port = x\n"), config);
+        CHECK(errors.size() == 1 && errors.front().kind == ErrorKind::kInvalidValue);
+        errors = parse_into("name = \"again\"\n" + Edit("retries = 3\n", ""), config);
+        CHECK(errors.size() == 2);
+        CHECK(errors.size() == 2 && errors[0].kind == ErrorKind::kDuplicateKey && errors[0].line == 2);
+        CHECK(errors.size() == 2 && errors[1].kind == ErrorKind::kMissingKey && errors[1].text == "server.retries");
+
+        Config unreadable;
+        errors = parse_into(std::filesystem::path("missing.omfl"), unreadable);
+        CHECK(errors.size() == 1 && errors.front().kind == ErrorKind::kUnreadableFile);
+    }
+}
+
+int main() {
+    TestBind();
+    TestMismatch();
+    TestMissing();
+    return Result();
+}
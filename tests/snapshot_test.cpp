@@ -0,0 +1,115 @@
+#include "check.h"
+
+#include "lib/snapshot.h"
+
+#include <fstream>
+#include <iterator>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    const std::string kText =
+        "title = \"snapshot\"\n"
+        "version = 3\n"
+        "ratio = -0.25\n"
+        "enabled = true\n"
+        "ints = [1, 2, 3]\n"
+        "mixed = [1, \"two\", [3.5, false]]\n"
+        "empty = []\n"
+        "[server]\n"
+        "host = \"localhost\"\n"
+        "ports = [8080, 8081]\n"
+        "[server.limits]\n"
+        "rate = 1.5\n"
+        "[client]\n"
+        "host = \"localhost\"\n";
+
+    std::string ReadFile(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void WriteFile(const std::filesystem::path& path, std::string_view bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    void TestRoundTrip() {
+        const Document document = parse(kText);
+        uint64_t hash = HashSource(kText);
+        CHECK(save_snapshot(document, "round_trip.snap", hash));
+
+        std::optional<Document> loaded = load_snapshot("round_trip.snap", hash);
+        CHECK(loaded.has_value());
+        if (!loaded) {
+            return;
+        }
+        CHECK(loaded->valid());
+        CHECK(Json(*loaded) == Json(document));
+        CHECK(loaded->Get("title").AsString() == "snapshot");
+        CHECK(loaded->Get("version").AsInt() == 3);
+        CHECK(loaded->Get("enabled").AsBool());
+        CHECK(loaded->Get("ints").AsIntSpan().size() == 3);
+        CHECK(loaded->Get("mixed")[2][0].AsFloat() == 3.5f);
+        CHECK(loaded->Get("server.ports")[1].AsInt() == 8081);
+        CHECK(loaded->Get("server.limits.rate").AsFloat() == 1.5f);
+        CHECK(!loaded->Get("server.missing").IsString());
+
+        // A copy outlives the mapping it was made from.
+        Document copy = loaded->Clone();
+        loaded.reset();
+        CHECK(Json(copy) == Json(document));
+    }
+
+    void TestRejected() {
+        const Document document = parse(kText);
+        uint64_t hash = HashSource(kText);
+        CHECK(save_snapshot(document, "rejected.snap", hash));
+
+        CHECK(!load_snapshot("rejected.snap", hash + 1));
+        CHECK(!load_snapshot("missing.snap", hash));
+        CHECK(!save_snapshot(parse(std::string("key = ")), "invalid.snap", hash));
+
+        std::string image = ReadFile("rejected.snap");
+        for (size_t size : {size_t(0), size_t(7), size_t(40), image.size() / 2, image.size() - 1}) {
+            WriteFile("truncated.snap", std::string_view(image).substr(0, size));
+            CHECK(!load_snapshot("truncated.snap", hash));
+        }
+        WriteFile("padded.snap", image + '\0');
+        CHECK(!load_snapshot("padded.snap", hash));
+
+        std::string corrupt = image;
+        corrupt[0] = 'X';
+        WriteFile("corrupt.snap", corrupt);
+        CHECK(!load_snapshot("corrupt.snap", hash));
+    }
+
+    void TestParseCached() {
+        // Documents from parse_cached map both files, so each one is gone before the
+        // files are written again.
+        WriteFile("cached.omfl", kText);
+        std::filesystem::remove("cached.snap");
+        std::string json = Json(parse_cached("cached.omfl", "cached.snap"));
+        CHECK(std::filesystem::exists("cached.snap"));
+        CHECK(Json(parse_cached("cached.omfl", "cached.snap")) == json);
+
+        // An edit of the source makes the old snapshot stale.
+        WriteFile("cached.omfl", "added = 1\n" + kText);
+        CHECK(parse_cached("cached.omfl", "cached.snap").Get("added").AsInt() == 1);
+        CHECK(parse_cached("cached.omfl", "cached.snap").Get("added").AsInt() == 1);
+
+        WriteFile("cached.omfl", "");
+        const Document empty = parse_cached("cached.omfl", "cached.snap");
+        CHECK(empty.valid());
+        CHECK(Json(empty) == Json(parse(std::string())));
+    }
+}
+
+int main() {
+    TestRoundTrip();
+    TestRejected();
+    TestParseCached();
+    return Result();
+}
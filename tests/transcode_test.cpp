@@ -0,0 +1,127 @@
+#include "check.h"
+
+#include "lib/transcode.h"
+
+#include <fstream>
+
+using namespace omfl;
+using namespace omfl::tests;
+
+namespace {
+
+    const Format kFormats[] = {Format::kJson, Format::kYaml, Format::kXml, Format::kMsgPack};
+
+    std::string TreeOutput(const Section& document, Format format) {
+        std::string output;
+        StringSink sink(output);
+        switch (format) {
+            case Format::kJson:
+                document.WriteJSON(sink);
+                break;
+            case Format::kYaml:
+                document.WriteYAML(sink);
+                break;
+            case Format::kXml:
+                document.WriteXML(sink);
+                break;
+            case Format::kMsgPack:
+                document.WriteMsgPack(sink);
+                break;
+        }
+        return output;
+    }
+
+    bool StreamOutput(const std::string& text, Format format, std::string& output) {
+        StringSink sink(output);
+        std::unique_ptr<Writer> writer = MakeWriter(format, sink);
+        return transcode(text, *writer);
+    }
+
+    // Streamed output must be byte for byte what the parsed tree writes.
+    void CheckSame(const std::string& text) {
+        const Document document = parse(text);
+        CHECK(document.valid());
+        for (Format format : kFormats) {
+            std::string output;
+            CHECK(StreamOutput(text, format, output));
+            CHECK(output == TreeOutput(document, format));
+        }
+    }
+
+    void CheckInvalid(const std::string& text) {
+        CHECK(!parse(text).valid());
+        for (Format format : kFormats) {
+            std::string output;
+            CHECK(!StreamOutput(text, format, output));
+        }
+    }
+
+    void TestValid() {
+        CheckSame("");
+        CheckSame("key = 1\n");
+        CheckSame("title = \"text <&> \\\\ \"\nratio = 0.5\nflags = [true, [false, []], \"x\"]\n"
+                  "[server]\nports = [1, 2]\n[server.limits]\nmax = 10\n");
+
+        // Sections reopened after others, including a parent reopened after its child.
+        CheckSame("[a]\nx = 1\n[b]\ny = 2\n[a]\nz = 3\n");
+        CheckSame("[a.b]\nx = 1\n[a]\ny = 2\n");
+        CheckSame("[a.b.c]\nx = 1\n[d]\ny = 2\n[a.b]\nz = 3\n[a]\nw = 4\n[a.b.c]\nv = 5\n");
+        CheckSame("root = 1\n[a]\nx = 1\n[a.b]\ny = 2\n[c]\n[a.b]\nz = 3\n[a.e]\n[a]\nq = [1, 2]\n");
+
+        // Many sections reopened out of order.
+        std::string text;
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < 200; i++) {
+                int section = (i * 37) % 200;
+                text += "[s" + std::to_string(section) + ".r" + std::to_string(round) + "]\n";
+                text += "k" + std::to_string(i) + " = \"" + std::to_string(round) + "\"\n";
+                text += "[s" + std::to_string(section) + "]\n";
+                text += "k" + std::to_string(round) + "_" + std::to_string(i) + " = " + std::to_string(i) + '\n';
+            }
+        }
+        CheckSame(text);
+    }
+
+    void TestInvalid() {
+        // A key and a section with the same name, in either order and across reopenings.
+        CheckInvalid("[a]\nb = 1\n[a.b]\nc = 2\n");
+        CheckInvalid("[a.b]\nc = 2\n[a]\nb = 1\n");
+        CheckInvalid("a = 1\n[a]\nb = 2\n");
+        CheckInvalid("[x]\n[a]\nb = 1\n[x]\n[a.b.c]\n");
+
+        // A key repeated in a reopened section.
+        CheckInvalid("[a]\nx = 1\n[b]\n[a]\nx = 2\n");
+
+        // Malformed lines and headers.
+        CheckInvalid("[a]\nbroken\n");
+        CheckInvalid("[a..b]\n");
+        CheckInvalid("key = [1, 2\n");
+    }
+
+    void TestFile() {
+        const std::string text = "[a.b]\nx = 1\n[a]\ny = \"two\"\n[c]\nz = [1.5]\n";
+        {
+            std::ofstream file("transcode.omfl", std::ios::binary | std::ios::trunc);
+            file << text;
+        }
+        for (Format format : kFormats) {
+            std::string output;
+            StringSink sink(output);
+            std::unique_ptr<Writer> writer = MakeWriter(format, sink);
+            CHECK(transcode(std::filesystem::path("transcode.omfl"), *writer));
+            CHECK(output == TreeOutput(parse(text), format));
+        }
+
+        std::string output;
+        StringSink sink(output);
+        std::unique_ptr<Writer> writer = MakeWriter(Format::kJson, sink);
+        CHECK(!transcode(std::filesystem::path("missing.omfl"), *writer));
+    }
+}
+
+int main() {
+    TestValid();
+    TestInvalid();
+    TestFile();
+    return Result();
+}